@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "bcast.h"
+
+int bcast_init(struct bcast *b, int num, int slot_bytes)
+{
+    int             i;
+
+    memset(b, 0, sizeof(struct bcast));
+
+    b->slots = calloc(num, sizeof(struct chunk));
+    b->mem = malloc((size_t) num * slot_bytes);
+    if (b->slots == NULL || b->mem == NULL)
+    {
+        bcast_free(b);
+        return -1;
+    }
+
+    b->size = num;
+    b->slot_bytes = slot_bytes;
+    for (i = 0; i < num; i++)
+    {
+        b->slots[i].pooled = 1;
+        b->slots[i].data = b->mem + (size_t) i *slot_bytes;
+    }
+
+    return 0;
+}
+
+void bcast_free(struct bcast *b)
+{
+    free(b->slots);
+    free(b->mem);
+    memset(b, 0, sizeof(struct bcast));
+}
+
+struct chunk   *bcast_publish(struct bcast *b, const uint8_t * data, int len,
+                              uint64_t epoch)
+{
+    struct chunk   *c = NULL;
+
+    if (len <= b->slot_bytes &&
+        __atomic_load_n(&b->slots[b->next].refs, __ATOMIC_ACQUIRE) == 0)
+    {
+        c = &b->slots[b->next];
+        b->next = (b->next + 1) % b->size;
+    }
+    else
+    {
+        c = malloc(sizeof(struct chunk) + len);
+        if (c == NULL)
+            return NULL;
+        c->pooled = 0;
+        c->data = (uint8_t *) (c + 1);
+        b->spares++;
+    }
+
+    c->refs = 1;
+    c->epoch = epoch;
+    c->len = len;
+    memcpy(c->data, data, len);
+
+    return c;
+}
+
+void chunk_put(struct chunk *c)
+{
+    if (__atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL) == 0 && !c->pooled)
+        free(c);
+}
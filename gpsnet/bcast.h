@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#ifndef __BCAST_H__
+#define __BCAST_H__
+
+#include <stdint.h>
+
+/* Immutable piece of output shared by all clients that queue it.
+ * References are counted atomically, queues of worker threads drop them
+ * while the publisher reuses slots.
+ */
+struct chunk {
+    int             refs;       /* references held by publisher and queues */
+    int             pooled;     /* slot of the ring, else malloc'd */
+    uint64_t        epoch;      /* receiver epoch the data belongs to */
+    int             stream;     /* output the data goes to, set by caller */
+    int             source;     /* input it came from, set by caller */
+    uint64_t        addr;       /* packed address field, set by caller */
+    int             len;        /* number of bytes in data */
+    uint8_t        *data;
+};
+
+/* Broadcast ring.
+ *
+ * Chunks are taken from a ring of preallocated slots in order. A slot is
+ * reused once no client queue refers to it any more; if the next slot is
+ * still held by a slow client, or the data does not fit a slot, the chunk
+ * is allocated on its own and freed with its last reference.
+ */
+struct bcast {
+    struct chunk   *slots;
+    uint8_t        *mem;        /* data of all slots */
+    int             size;       /* number of slots */
+    int             slot_bytes; /* data bytes per slot */
+    int             next;       /* next slot to use */
+    uint64_t        spares;     /* chunks allocated outside the ring */
+};
+
+/** Allocate a ring of num slots of slot_bytes each.
+ *  @returns 0 on success, -1 if out of memory.
+ */
+int             bcast_init(struct bcast *b, int num, int slot_bytes);
+void            bcast_free(struct bcast *b);
+
+/** Copy data into a new chunk.
+ *  @returns The chunk with one reference for the caller, NULL if out of
+ *           memory.
+ */
+struct chunk   *bcast_publish(struct bcast *b, const uint8_t * data, int len,
+                              uint64_t epoch);
+
+static inline void chunk_get(struct chunk *c)
+{
+    __atomic_add_fetch(&c->refs, 1, __ATOMIC_RELAXED);
+}
+
+/** Take n more references at once. */
+static inline void chunk_get_n(struct chunk *c, int n)
+{
+    __atomic_add_fetch(&c->refs, n, __ATOMIC_RELAXED);
+}
+
+void            chunk_put(struct chunk *c);
+
+#endif
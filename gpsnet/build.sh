@@ -1 +1,4 @@
-gcc -Wall -O2 -o gpsnet gpsnet.c common.c
+gcc -Wall -O2 -o gpsnet gpsnet.c common.c queue.c bcast.c filter.c spsc.c uring.c -lpthread
+gcc -Wall -O2 -o gpsreplay gpsreplay.c common.c
+make -C ../nmealib
+gcc -Wall -O2 -I../nmealib/include -o gpsfleet gpsfleet.c common.c -L../nmealib/lib -lnmea -lm -lpthread
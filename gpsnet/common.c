@@ -6,13 +6,19 @@
  * Simplified BSD License. See license.txt for details.
  *
  */
+#define _GNU_SOURCE             /* ptsname_r() */
 #include <errno.h>
 #include <fcntl.h>              /* O_WRONLY */
+#include <netdb.h>
+#include <netinet/in.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/time.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "common.h"
@@ -127,56 +133,349 @@ int gps_open(const char *port, int speed, int blocking)
     return gps_fd;
 }
 
+int pty_open(char *name, size_t name_len)
+{
+    int             pty_fd, slave_fd;
+    struct termios  tty;
+
+    pty_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (pty_fd == -1)
+    {
+        fprintf(stderr, "Error opening pty: %d (%s)\n", errno,
+                strerror(errno));
+        return -1;
+    }
+
+    if (grantpt(pty_fd) == -1 || unlockpt(pty_fd) == -1 ||
+        ptsname_r(pty_fd, name, name_len) != 0)
+    {
+        fprintf(stderr, "Error setting up pty: %d (%s)\n", errno,
+                strerror(errno));
+        close(pty_fd);
+        return -1;
+    }
+
+    /* no echo or line processing on the slave side */
+    slave_fd = open(name, O_RDWR | O_NOCTTY);
+    if (slave_fd != -1)
+    {
+        if (tcgetattr(slave_fd, &tty) == 0)
+        {
+            cfmakeraw(&tty);
+            tcsetattr(slave_fd, TCSANOW, &tty);
+        }
+        close(slave_fd);
+    }
+
+    return pty_fd;
+}
+
+int tcp_listen(int port, int backlog, int shared)
+{
+    int             sock_fd;
+    int             yes = 1;
+    struct sockaddr_in serv_addr;
+
+    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock_fd == -1)
+    {
+        fprintf(stderr, "Error creating socket: %d: %s\n", errno,
+                strerror(errno));
+        return -1;
+    }
+
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == -1)
+        fprintf(stderr, "Error setting SO_REUSEADDR: %d: %s\n", errno,
+                strerror(errno));
+
+    if (shared &&
+        setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1)
+    {
+        fprintf(stderr, "Error setting SO_REUSEPORT: %d: %s\n", errno,
+                strerror(errno));
+        close(sock_fd);
+        return -1;
+    }
 
-int read_data(int fd, struct xfr_buf *buffer)
+    /* bind socket to host address */
+    memset(&serv_addr, 0, sizeof(struct sockaddr_in));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_addr.s_addr = INADDR_ANY;
+    serv_addr.sin_port = htons(port);
+    if (bind(sock_fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) == -1)
+    {
+        fprintf(stderr, "bind() error: %d: %s\n", errno, strerror(errno));
+        close(sock_fd);
+        return -1;
+    }
+
+    if (listen(sock_fd, backlog) == -1)
+    {
+        fprintf(stderr, "listen() error: %d: %s\n", errno, strerror(errno));
+        close(sock_fd);
+        return -1;
+    }
+
+    return sock_fd;
+}
+
+int tcp_connect(const char *host, int port)
 {
-    uint8_t        *buf = buffer->data;
-    int             type = MSG_TYPE_INCOMPLETE;
-    size_t          num;
+    struct addrinfo hints, *res, *ai;
+    char            service[16];
+    int             sock_fd = -1;
+    int             err;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(service, sizeof(service), "%d", port);
+
+    err = getaddrinfo(host, service, &hints, &res);
+    if (err != 0)
+    {
+        fprintf(stderr, "Can't resolve %s: %s\n", host, gai_strerror(err));
+        return -1;
+    }
+
+    for (ai = res; ai != NULL; ai = ai->ai_next)
+    {
+        sock_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock_fd == -1)
+            continue;
+        if (connect(sock_fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(sock_fd);
+        sock_fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (sock_fd == -1)
+        fprintf(stderr, "Can't connect to %s:%d: %d: %s\n", host, port,
+                errno, strerror(errno));
+
+    return sock_fd;
+}
+
+void framer_init(struct framer *f, int check_crc)
+{
+    memset(f, 0, sizeof(struct framer));
+    f->check_crc = check_crc;
+}
+
+/* Move the tail to the front to make room for more data */
+static void framer_compact(struct framer *f)
+{
+    if (f->start > 0)
+    {
+        memmove(f->data, f->data + f->start, f->len - f->start);
+        f->len -= f->start;
+        f->start = 0;
+    }
+
+    /* no line feed in a full buffer, nothing to keep */
+    if (f->len == RDBUF_SIZE)
+    {
+        f->invalid_pkts++;
+        f->len = 0;
+    }
+}
+
+int framer_push(struct framer *f, const uint8_t * data, int len)
+{
+    framer_compact(f);
+
+    if (len > RDBUF_SIZE - f->len)
+        len = RDBUF_SIZE - f->len;
 
-    /* read data */
-    num = read(fd, &buf[buffer->wridx], RDBUF_SIZE - buffer->wridx);
+    memcpy(f->data + f->len, data, len);
+    f->len += len;
+
+    return len;
+}
+
+int framer_read(struct framer *f, int fd)
+{
+    ssize_t         num;
+
+    framer_compact(f);
+
+    num = read(fd, f->data + f->len, RDBUF_SIZE - f->len);
 
     if (num > 0)
     {
-        buffer->wridx += num;
+        /* a single zero byte is EOF from some serial drivers */
+        if (num == 1 && f->len == 0 && f->data[0] == 0x00)
+            return MSG_TYPE_EOF;
+
+        f->len += num;
+        return MSG_TYPE_INCOMPLETE;
+    }
 
-        /* There is at least one character in the buffer */
-        if (buf[0] == '$')
+    if (num == 0)
+    {
+        fprintf(stderr, "Received EOF from FD %d\n", fd);
+        return MSG_TYPE_EOF;
+    }
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        return MSG_TYPE_INCOMPLETE;
+
+    fprintf(stderr, "Error reading from FD %d: %d: %s\n", fd, errno,
+            strerror(errno));
+
+    return MSG_TYPE_INVALID;
+}
+
+static int hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/* Check the *hh checksum of a sentence, if it has one */
+static int checksum_ok(const uint8_t * line, int len)
+{
+    uint8_t         sum = 0;
+    int             i, hi, lo;
+
+    for (i = 1; i < len && line[i] != '*'; i++)
+        sum ^= line[i];
+
+    if (i == len)
+        return 1;
+
+    if (i + 2 >= len)
+        return 0;
+
+    hi = hex_value(line[i + 1]);
+    lo = hex_value(line[i + 2]);
+
+    return hi >= 0 && lo >= 0 && sum == (hi << 4 | lo);
+}
+
+int framer_next(struct framer *f, const uint8_t ** line, int *len)
+{
+    uint8_t        *p;
+    int             i, end;
+
+    while (f->start < f->len)
+    {
+        /* resync on '$' */
+        p = memchr(f->data + f->start, '$', f->len - f->start);
+        if (p == NULL)
         {
-            if (buf[buffer->wridx - 1] == 0x0A)
-                type = MSG_TYPE_VALID;
-            else
-                type = MSG_TYPE_INCOMPLETE;
+            for (i = f->start; i < f->len; i++)
+                if (f->data[i] != '\r' && f->data[i] != '\n')
+                    f->skipped++;
+            f->start = f->len;
+            break;
         }
-        else if ((buf[0] == 0x0A) && (buffer->wridx == 1))
+
+        for (i = f->start; i < p - f->data; i++)
+            if (f->data[i] != '\r' && f->data[i] != '\n')
+                f->skipped++;
+        f->start = p - f->data;
+
+        /* find the end, a new '$' on the way means this one is broken */
+        for (end = f->start + 1; end < f->len; end++)
+            if (f->data[end] == '\n' || f->data[end] == '$')
+                break;
+
+        if (end == f->len)
         {
-            /* single line feed character -> ignore */
-            buffer->wridx = 0;
-            type = MSG_TYPE_INCOMPLETE;
+            /* keep the tail unless it can never become a sentence */
+            if (f->len - f->start > MAX_SENTENCE)
+            {
+                f->invalid_pkts++;
+                f->start = f->len;
+            }
+            break;
         }
-        else if ((buf[0] == 0x00) && (buffer->wridx == 1))
+
+        if (f->data[end] == '$' || end + 1 - f->start > MAX_SENTENCE)
         {
-            type = MSG_TYPE_EOF;
+            f->invalid_pkts++;
+            f->start = end + (f->data[end] == '$' ? 0 : 1);
+            continue;
         }
-        else
+
+        *line = f->data + f->start;
+        *len = end + 1 - f->start;
+        f->start = end + 1;
+
+        /* checksum covers the bytes before CR LF */
+        if (f->check_crc && !checksum_ok(*line, *len - 1 -
+                                         ((*line)[*len - 2] == '\r')))
         {
-            type = MSG_TYPE_INVALID;
+            f->crc_errors++;
+            continue;
         }
+
+        f->valid_pkts++;
+        return MSG_TYPE_VALID;
     }
-    else if (num == 0)
-    {
-        type = MSG_TYPE_EOF;
-        fprintf(stderr, "Received EOF from FD %d\n", fd);
-    }
+
+    return MSG_TYPE_INCOMPLETE;
+}
+
+/* Parse hhmmss[.sss] into seconds since midnight */
+static int parse_tod(const char *str, size_t len, double *tod)
+{
+    double          frac = 0.0;
+    double          scale = 0.1;
+    size_t          i;
+
+    if (len < 6)
+        return 0;
+
+    for (i = 0; i < 6; i++)
+        if (str[i] < '0' || str[i] > '9')
+            return 0;
+
+    for (i = 7; i < len && str[6] == '.' && str[i] >= '0' && str[i] <= '9';
+         i++, scale *= 0.1)
+        frac += (str[i] - '0') * scale;
+
+    *tod = ((str[0] - '0') * 10 + str[1] - '0') * 3600.0 +
+        ((str[2] - '0') * 10 + str[3] - '0') * 60.0 +
+        (str[4] - '0') * 10 + str[5] - '0' + frac;
+
+    return 1;
+}
+
+int sentence_time(const char *line, size_t len, double *tod)
+{
+    const char     *field;
+    const char     *end = line + len;
+    int             idx;
+    int             i;
+
+    /* $ttGGA, $ttRMC and $ttZDA have time in field 1, $ttGLL in field 5 */
+    if (len < 7 || line[0] != '$')
+        return 0;
+
+    if (memcmp(line + 3, "GGA,", 4) == 0 || memcmp(line + 3, "RMC,", 4) == 0
+        || memcmp(line + 3, "ZDA,", 4) == 0)
+        idx = 1;
+    else if (memcmp(line + 3, "GLL,", 4) == 0)
+        idx = 5;
     else
-    {
-        type = MSG_TYPE_INVALID;
-        fprintf(stderr, "Error reading from FD %d: %d: %s\n", fd, errno,
-                strerror(errno));
-    }
+        return 0;
+
+    for (field = line, i = 0; i < idx && field < end; field++)
+        if (*field == ',')
+            i++;
 
-    return type;
+    for (len = 0; field + len < end && field[len] != ',' &&
+         field[len] != '*'; len++) ;
+
+    return parse_tod(field, len, tod);
 }
 
 uint64_t time_ms(void)
@@ -196,3 +495,12 @@ uint64_t time_us(void)
 
     return 1e6 * tval.tv_sec + tval.tv_usec;
 }
+
+uint64_t time_mono_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return 1000ULL * ts.tv_sec + ts.tv_nsec / 1000000;
+}
@@ -9,6 +9,7 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* Use 1 = debug, 0 = release */
@@ -17,12 +18,27 @@
 /* Read buffer size */
 #define RDBUF_SIZE 2048
 
-/* convenience struct for data transfers */
-struct xfr_buf {
+/* Longest sentence accepted, NMEA 0183 allows 82 but proprietary
+   sentences are often longer */
+#define MAX_SENTENCE 256
+
+/* Incremental NMEA framer.
+ *
+ * Bytes read from a stream are kept until they form whole sentences from
+ * '$' up to and including the line feed. A read may hold several
+ * sentences or end in the middle of one; the tail is kept for the next
+ * read. Bytes outside of sentences are skipped, and a '$' before the end
+ * of a sentence starts over from there.
+ */
+struct framer {
     uint8_t         data[RDBUF_SIZE];
-    int             wridx;      /* next available write slot. */
-    uint64_t        valid_pkts; /* number of valid packets */
-    uint64_t        invalid_pkts;       /* number of invalid packets */
+    int             start;      /* first byte not yet framed */
+    int             len;        /* bytes in data */
+    int             check_crc;  /* drop sentences with a wrong checksum */
+    uint64_t        valid_pkts; /* number of valid sentences */
+    uint64_t        invalid_pkts;       /* broken or too long sentences */
+    uint64_t        crc_errors; /* sentences with wrong checksum */
+    uint64_t        skipped;    /* bytes outside of sentences */
 };
 
 
@@ -31,32 +47,81 @@ struct xfr_buf {
 #define MSG_TYPE_VALID          1
 #define MSG_TYPE_EOF            2
 
-/** Read data from file descriptor.
- *  @param  fd      The file descriptor.
- *  @param  buffer  Pointer to the serial_buffer structure to use.
- *  @returns The packet type if the packet is complete.
- *
- * This function will read all available data from the UART and put the
- * data into the buffer starting at index buffer->wridx. When the read
- * is finished buffer->wridx will again point to the first available
- * slot in buffer, which mneans that it is also equal to the number of
- * bytes in the buffer.
- *
- * If the last byte read was 0xFD the packet is considered complete
- * and the function will return the packet type. The caller can use this
- * information to decide what to do with the data.
+void            framer_init(struct framer *f, int check_crc);
+
+/** Read available data from file descriptor into the framer.
+ *  @param  fd  The file descriptor.
+ *  @param  f   The framer.
+ *  @returns MSG_TYPE_EOF at end of file, MSG_TYPE_INVALID on read error
+ *           and MSG_TYPE_INCOMPLETE otherwise.
  *
- * If the last byte is not 0xFD then the read is only partial and the
- * function returns MSG_TYPE_INCOMPLETE to indicate this to the caller.
+ * Call framer_next() afterwards until it returns MSG_TYPE_INCOMPLETE.
+ */
+int             framer_read(struct framer *f, int fd);
+
+/** Add data read by other means to the framer.
+ *  @param  f     The framer.
+ *  @param  data  The data.
+ *  @param  len   Number of bytes.
+ *  @returns Number of bytes taken, less than len only if more than
+ *           RDBUF_SIZE - MAX_SENTENCE bytes are pushed between calls to
+ *           framer_next().
+ */
+int             framer_push(struct framer *f, const uint8_t * data, int len);
+
+/** Get the next whole sentence.
+ *  @param  f     The framer.
+ *  @param  line  Set to the sentence, valid until the next framer_read().
+ *  @param  len   Set to the length of the sentence.
+ *  @returns MSG_TYPE_VALID if a sentence was found, MSG_TYPE_INCOMPLETE
+ *           if the rest of the data is not a whole sentence yet.
  */
-int             read_data(int fd, struct xfr_buf *buffer);
+int             framer_next(struct framer *f, const uint8_t ** line,
+                            int *len);
 
 int             gps_open(const char *port, int speed, int blocking);
 
+/** Open a pseudo-terminal.
+ *  @param  name      Buffer for the name of the slave device.
+ *  @param  name_len  Size of the name buffer.
+ *  @returns The non-blocking master file descriptor or -1 on error.
+ *
+ * The slave end is put into raw mode so that it can be opened with
+ * gps_open() like a real UART.
+ */
+int             pty_open(char *name, size_t name_len);
+
+/** Create a TCP socket listening on all interfaces.
+ *  @param  port     The port number.
+ *  @param  backlog  The listen() backlog.
+ *  @param  shared   Set SO_REUSEPORT, so that several sockets share the
+ *                   port and the kernel spreads connections over them.
+ *  @returns The socket file descriptor or -1 on error.
+ */
+int             tcp_listen(int port, int backlog, int shared);
+
+/** Connect to a TCP server.
+ *  @param  host     Host name or address.
+ *  @param  port     The port number.
+ *  @returns The socket file descriptor or -1 on error.
+ */
+int             tcp_connect(const char *host, int port);
+
+/** Get the UTC time of day of an NMEA sentence.
+ *  @param  line  The sentence, starting with '$'.
+ *  @param  len   Length of the sentence.
+ *  @param  tod   Set to the time in seconds since midnight.
+ *  @returns 1 if the sentence has a time (GGA, RMC, ZDA, GLL), 0 if not.
+ */
+int             sentence_time(const char *line, size_t len, double *tod);
+
 /** Get current time in milliseconds. */
 uint64_t        time_ms(void);
 
 /** Get current time in microseconds. */
 uint64_t        time_us(void);
 
+/** Get monotonic time in milliseconds, for timeouts. */
+uint64_t        time_mono_ms(void);
+
 #endif
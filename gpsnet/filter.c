@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#include <ctype.h>
+#include <string.h>
+
+#include "filter.h"
+
+/* Characters of the address field */
+#define ADDR_LEN        5
+
+uint64_t filter_address(const uint8_t * line, int len)
+{
+    uint64_t        addr = 0;
+    int             i;
+
+    for (i = 0; i < ADDR_LEN && i + 1 < len && line[i + 1] != ','; i++)
+        addr |= (uint64_t) line[i + 1] << (8 * i);
+
+    return addr;
+}
+
+void filter_all(struct filter *f)
+{
+    memset(f, 0, sizeof(struct filter));
+    f->sources = ~0u;
+}
+
+/* Add a pattern, see struct filter */
+static int add_pattern(struct filter *f, const char *pat, int len)
+{
+    uint64_t        value = 0, mask = 0;
+    int             i, pos;
+
+    if (len > ADDR_LEN || f->num == FILTER_PATTERNS)
+        return -1;
+
+    /* a sentence type is the end of the address */
+    pos = (len == 3) ? ADDR_LEN - 3 : 0;
+
+    for (i = 0; i < len; i++, pos++)
+    {
+        if (pat[i] == '?')
+            continue;
+        value |= (uint64_t) toupper((unsigned char)pat[i]) << (8 * pos);
+        mask |= (uint64_t) 0xff << (8 * pos);
+    }
+
+    f->value[f->num] = value;
+    f->mask[f->num] = mask;
+    f->num++;
+
+    return 0;
+}
+
+int filter_parse(struct filter *f, const char *text,
+                 char *const *names, int num_names)
+{
+    const char     *tok = text;
+    uint32_t        sources = 0;
+    int             len, i;
+
+    memset(f, 0, sizeof(struct filter));
+
+    while (*tok != '\0')
+    {
+        len = strcspn(tok, ", \t\r\n");
+        if (len == 0)
+        {
+            tok++;
+            continue;
+        }
+
+        if (tok[0] == '@')
+        {
+            for (i = 0; i < num_names; i++)
+                if ((int)strlen(names[i]) == len - 1 &&
+                    strncmp(names[i], tok + 1, len - 1) == 0)
+                    break;
+            if (i == num_names)
+                return -1;
+            sources |= 1u << i;
+        }
+        else if (!(len == 1 && tok[0] == '*') &&
+                 add_pattern(f, tok, len) == -1)
+        {
+            return -1;
+        }
+
+        tok += len;
+    }
+
+    f->sources = sources ? sources : ~0u;
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <stdint.h>
+
+#include "bcast.h"
+
+/* Max address patterns of one filter */
+#define FILTER_PATTERNS 16
+
+/* Subscription filter of a client.
+ *
+ * A sentence passes if its address field matches one of the patterns and
+ * it comes from one of the sources. The 5 character address field is
+ * packed into an integer once per sentence, so a pattern is a single
+ * compare under a mask:
+ *
+ *   GGA     three characters are a sentence type of any talker
+ *   GP      other lengths match the start of the address, so GP is all
+ *           GPS sentences and P all proprietary ones
+ *   ?P?GA   '?' matches any character
+ */
+struct filter {
+    int             num;        /* number of patterns, 0 passes all */
+    uint64_t        value[FILTER_PATTERNS];
+    uint64_t        mask[FILTER_PATTERNS];
+    uint32_t        sources;    /* bit per source index */
+};
+
+/** Pack the address field of a sentence starting with '$'. */
+uint64_t        filter_address(const uint8_t * line, int len);
+
+/** Set a filter that passes everything. */
+void            filter_all(struct filter *f);
+
+/** Parse a filter from patterns and @source names separated by commas
+ *  or spaces; no patterns or no sources mean all of them.
+ *  @param  names        Source names, index is the source bit.
+ *  @param  num_names    Number of names.
+ *  @returns 0 on success, -1 on an unknown source or a bad pattern.
+ */
+int             filter_parse(struct filter *f, const char *text,
+                             char *const *names, int num_names);
+
+static inline int filter_match(const struct filter *f, const struct chunk *c)
+{
+    int             i;
+
+    if (!(f->sources & (1u << c->source)))
+        return 0;
+
+    if (f->num == 0)
+        return 1;
+
+    for (i = 0; i < f->num; i++)
+        if ((c->addr & f->mask[i]) == f->value[i])
+            return 1;
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+
+/*
+ * gpsfleet - simulate many GPS receivers for load testing gpsnet.
+ *
+ * Every receiver is an independent nmealib generator with its own seed.
+ * Epochs are produced at a fixed rate and written out no faster than the
+ * configured baud rate would allow, to a pty, a fifo or a TCP socket.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>           // PRId64 and PRIu64
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nmea/nmea.h>
+
+#include "common.h"
+
+
+#define OUT_PTY         0
+#define OUT_FIFO        1
+#define OUT_TCP         2
+
+/* smallest write when pacing output to the baud rate */
+#define MIN_CHUNK       16
+
+/* seconds between statistics reports */
+#define STATS_INTERVAL  10
+
+struct receiver {
+    nmeaGENSTREAM   gen;
+    int             fd;         /* output, -1 if there is no client */
+    int             listen_fd;  /* listening socket in TCP mode */
+    char            name[64];   /* name of the output */
+    char            buf[NMEA_EPOCH_BUFF];
+    int             len;        /* bytes in current epoch */
+    int             sent;       /* bytes of current epoch written */
+    uint64_t        next_epoch; /* time of next epoch in us */
+    uint64_t        tx_start;   /* time current epoch started in us */
+    uint64_t        tx_end;     /* time current epoch is on the wire in us */
+    uint64_t        due;        /* next time this receiver needs service */
+};
+
+struct fleet_stats {
+    uint64_t        epochs;     /* epochs generated */
+    uint64_t        bytes;      /* bytes written */
+    uint64_t        dropped;    /* epochs not (completely) written */
+    uint64_t        missed;     /* epochs skipped because we were late */
+    uint64_t        late_sum;   /* sum of scheduling delays in us */
+    uint64_t        late_max;   /* largest scheduling delay in us */
+};
+
+static int      num_rx = 1;     /* number of receivers */
+static int      rate = 1;       /* epochs per second */
+static int      speed = 4800;   /* baud rate, 0 means unpaced */
+static int      out_mode = OUT_PTY;
+static char    *fifo_dir = NULL;
+static int      port = 46000;   /* first TCP port */
+static int      gen_type = NMEA_GEN_ROTATE;
+static int      gen_mask = GPGGA | GPGSA | GPGSV | GPRMC | GPVTG;
+static unsigned int seed = 1;
+static int      spread = 0;     /* spread epochs over the period */
+static int      run_time = 0;   /* seconds, 0 means forever */
+static int      keep_running = 1;
+
+static struct fleet_stats stats;
+
+
+void signal_handler(int signo)
+{
+    if (signo == SIGINT)
+        fprintf(stderr, "\nCaught SIGINT\n");
+    else if (signo == SIGTERM)
+        fprintf(stderr, "\nCaught SIGTERM\n");
+    else
+        fprintf(stderr, "\nCaught signal: %d\n", signo);
+
+    keep_running = 0;
+}
+
+static void help(void)
+{
+    static const char help_string[] =
+        "\n Usage: gpsfleet [options]\n"
+        "\n Possible options are:\n"
+        "\n"
+        "  -n num    Number of receivers (default is 1).\n"
+        "  -r rate   Epochs per second, 1 to 20 (default is 1).\n"
+        "  -s speed  Baud rate used for pacing, 0 for none (default is 4800).\n"
+        "  -o out    Output: pty, fifo or tcp (default is pty).\n"
+        "  -f dir    Directory for the fifos (default is /tmp).\n"
+        "  -p port   First TCP port, receiver N uses port+N (default is 46000).\n"
+        "  -g type   Generator: noise, static or rotate (default is rotate).\n"
+        "  -e list   Sentences, e.g. gga,rmc (default is gga,gsa,gsv,rmc,vtg).\n"
+        "  -S seed   Seed of the first receiver (default is 1).\n"
+        "  -a        Spread the receivers' epochs over the period.\n"
+        "  -t secs   Stop after this many seconds.\n"
+        "  -h        This help message.\n\n"
+        " The outputs are listed on stdout, one per line.\n\n";
+
+    fprintf(stderr, "%s", help_string);
+}
+
+static int parse_mask(const char *list)
+{
+    static const struct {
+        const char     *name;
+        int             mask;
+    } types[] = {
+        {"gga", GPGGA}, {"gsa", GPGSA}, {"gsv", GPGSV},
+        {"rmc", GPRMC}, {"vtg", GPVTG}
+    };
+    int             mask = 0;
+    size_t          i;
+
+    for (i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+        if (strstr(list, types[i].name) != NULL)
+            mask |= types[i].mask;
+
+    return mask;
+}
+
+/* Parse command line options */
+static void parse_options(int argc, char **argv)
+{
+    int             option;
+
+    if (argc > 1)
+    {
+        while ((option = getopt(argc, argv, "n:r:s:o:f:p:g:e:S:at:h")) != -1)
+        {
+            switch (option)
+            {
+            case 'n':
+                num_rx = atoi(optarg);
+                break;
+
+            case 'r':
+                rate = atoi(optarg);
+                break;
+
+            case 's':
+                speed = atoi(optarg);
+                break;
+
+            case 'o':
+                if (strcmp(optarg, "fifo") == 0)
+                    out_mode = OUT_FIFO;
+                else if (strcmp(optarg, "tcp") == 0)
+                    out_mode = OUT_TCP;
+                else if (strcmp(optarg, "pty") == 0)
+                    out_mode = OUT_PTY;
+                else
+                {
+                    fprintf(stderr, "Unknown output: %s\n", optarg);
+                    help();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'f':
+                fifo_dir = strdup(optarg);
+                break;
+
+            case 'p':
+                port = atoi(optarg);
+                break;
+
+            case 'g':
+                if (strcmp(optarg, "noise") == 0)
+                    gen_type = NMEA_GEN_NOISE;
+                else if (strcmp(optarg, "static") == 0)
+                    gen_type = NMEA_GEN_STATIC;
+                else
+                    gen_type = NMEA_GEN_ROTATE;
+                break;
+
+            case 'e':
+                gen_mask = parse_mask(optarg);
+                break;
+
+            case 'S':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'a':
+                spread = 1;
+                break;
+
+            case 't':
+                run_time = atoi(optarg);
+                break;
+
+            case 'h':
+                help();
+                exit(EXIT_SUCCESS);
+
+            default:
+                help();
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    if (num_rx < 1)
+        num_rx = 1;
+    if (rate < 1)
+        rate = 1;
+    if (rate > 20)
+        rate = 20;
+    if (speed < 0)
+        speed = 0;
+    if (gen_mask == 0)
+        gen_mask = GPGGA | GPRMC;
+    if (fifo_dir == NULL)
+        fifo_dir = strdup("/tmp");
+}
+
+/* thousands of outputs need more than the default 1024 descriptors */
+static void raise_fd_limit(void)
+{
+    struct rlimit   rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static int open_output(struct receiver *rx, int idx)
+{
+    switch (out_mode)
+    {
+    case OUT_FIFO:
+        snprintf(rx->name, sizeof(rx->name), "%s/gps%d", fifo_dir, idx);
+        if (mkfifo(rx->name, 0666) == -1 && errno != EEXIST)
+        {
+            fprintf(stderr, "mkfifo(%s) error: %d: %s\n", rx->name, errno,
+                    strerror(errno));
+            return -1;
+        }
+        /* O_RDWR keeps the fifo open while there are no readers */
+        rx->fd = open(rx->name, O_RDWR | O_NONBLOCK);
+        return rx->fd;
+
+    case OUT_TCP:
+        snprintf(rx->name, sizeof(rx->name), "tcp:%d", port + idx);
+        rx->listen_fd = tcp_listen(port + idx, 1, 0);
+        if (rx->listen_fd != -1)
+            fcntl(rx->listen_fd, F_SETFL, O_NONBLOCK);
+        return rx->listen_fd;
+
+    default:
+        rx->fd = pty_open(rx->name, sizeof(rx->name));
+        return rx->fd;
+    }
+}
+
+static void close_output(struct receiver *rx)
+{
+    if (rx->fd != -1)
+        close(rx->fd);
+    if (rx->listen_fd != -1)
+        close(rx->listen_fd);
+    if (out_mode == OUT_FIFO)
+        unlink(rx->name);
+
+    rx->fd = -1;
+    rx->listen_fd = -1;
+}
+
+/* Random start position within 20 km of the generator default */
+static void scatter_position(struct receiver *rx)
+{
+    nmeaPOS         pos;
+
+    nmea_info2pos(&rx->gen.info, &pos);
+    nmea_move_horz(&pos, &pos, nmea_random_r(&rx->gen.rnd, 0, 359),
+                   nmea_random_r(&rx->gen.rnd, 0, 20));
+    nmea_pos2info(&pos, &rx->gen.info);
+}
+
+/* Generate next epoch or write the next part of the current one */
+static void service_receiver(struct receiver *rx, uint64_t now,
+                             uint64_t period)
+{
+    uint64_t        late;
+    ssize_t         written;
+    int             allowed;
+    int             chunk;
+
+    if (rx->sent >= rx->len)
+    {
+        if (now < rx->next_epoch || now < rx->tx_end)
+        {
+            rx->due = rx->next_epoch > rx->tx_end ?
+                rx->next_epoch : rx->tx_end;
+            return;
+        }
+
+        rx->len = nmea_stream_generate(&rx->gen, rx->buf, sizeof(rx->buf),
+                                       gen_mask);
+        rx->sent = 0;
+        rx->tx_start = now;
+        rx->tx_end = now;
+        if (speed)
+            rx->tx_end += (uint64_t) rx->len * 10000000 / speed;
+
+        late = now - rx->next_epoch;
+        stats.late_sum += late;
+        if (late > stats.late_max)
+            stats.late_max = late;
+        stats.epochs++;
+
+        rx->next_epoch += period;
+        while (rx->next_epoch <= now)
+        {
+            rx->next_epoch += period;
+            stats.missed++;
+        }
+    }
+
+    /* bytes the UART would have sent by now, plus one chunk */
+    chunk = speed / 10000 > MIN_CHUNK ? speed / 10000 : MIN_CHUNK;
+    allowed = rx->len;
+    if (speed &&
+        (now - rx->tx_start) * speed / 10000000 + chunk < (uint64_t) rx->len)
+        allowed = (now - rx->tx_start) * speed / 10000000 + chunk;
+
+    if (allowed > rx->sent)
+    {
+        if (rx->fd == -1)
+            written = -1;
+        else
+            written = write(rx->fd, rx->buf + rx->sent, allowed - rx->sent);
+
+        if (written > 0)
+        {
+            rx->sent += written;
+            stats.bytes += written;
+        }
+        else
+        {
+            /* nobody is reading, drop the epoch like a UART would */
+            if (written == -1 && rx->fd != -1 && errno != EAGAIN &&
+                out_mode == OUT_TCP)
+            {
+                fprintf(stderr, "Connection closed (%s)\n", rx->name);
+                close(rx->fd);
+                rx->fd = -1;
+            }
+            rx->sent = rx->len;
+            stats.dropped++;
+        }
+    }
+
+    if (rx->sent < rx->len && speed)
+        rx->due = rx->tx_start + (uint64_t) rx->sent * 10000000 / speed;
+    else if (rx->sent < rx->len)
+        rx->due = now + 1000;
+    else
+        rx->due = rx->next_epoch > rx->tx_end ? rx->next_epoch : rx->tx_end;
+}
+
+/* min-heap of receiver indices ordered by due time */
+static void heap_sift_down(struct receiver *rx, int *heap, int num, int i)
+{
+    int             child;
+    int             tmp;
+
+    while ((child = 2 * i + 1) < num)
+    {
+        if (child + 1 < num && rx[heap[child + 1]].due < rx[heap[child]].due)
+            child++;
+        if (rx[heap[i]].due <= rx[heap[child]].due)
+            break;
+
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+static void accept_clients(struct receiver *rx, struct pollfd *poll_fds)
+{
+    int             i;
+    int             new;
+
+    for (i = 0; i < num_rx; i++)
+    {
+        if (!(poll_fds[i].revents & POLLIN))
+            continue;
+
+        new = accept(rx[i].listen_fd, NULL, NULL);
+        if (new == -1)
+            continue;
+
+        /* one client per receiver, the newest one wins */
+        if (rx[i].fd != -1)
+            close(rx[i].fd);
+
+        fcntl(new, F_SETFL, O_NONBLOCK);
+        rx[i].fd = new;
+        fprintf(stderr, "Connection accepted (%s, FD=%d)\n", rx[i].name, new);
+    }
+}
+
+static void print_stats(uint64_t elapsed)
+{
+    fprintf(stderr,
+            "%" PRIu64 " s: epochs %" PRIu64 ", bytes %" PRIu64
+            ", dropped %" PRIu64 ", missed %" PRIu64
+            ", delay avg %" PRIu64 " us max %" PRIu64 " us\n",
+            elapsed, stats.epochs, stats.bytes, stats.dropped, stats.missed,
+            stats.epochs ? stats.late_sum / stats.epochs : 0,
+            stats.late_max);
+}
+
+int main(int argc, char **argv)
+{
+    int             exit_code = EXIT_FAILURE;
+    struct receiver *rx;
+    struct pollfd  *poll_fds = NULL;
+    int            *heap;
+    uint64_t        period;
+    uint64_t        start = time_us();
+    uint64_t        now;
+    uint64_t        next_stats;
+    int64_t         wait_us;
+    int             num_ready = 0;      /* receivers to clean up */
+    int             i;
+
+    parse_options(argc, argv);
+
+    /* setup signal handler */
+    if (signal(SIGINT, signal_handler) == SIG_ERR)
+        printf("Warning: Can't catch SIGINT\n");
+    if (signal(SIGTERM, signal_handler) == SIG_ERR)
+        printf("Warning: Can't catch SIGTERM\n");
+    signal(SIGPIPE, SIG_IGN);
+
+    raise_fd_limit();
+
+    rx = calloc(num_rx, sizeof(struct receiver));
+    heap = calloc(num_rx, sizeof(int));
+    if (rx == NULL || heap == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    period = 1000000 / rate;
+
+    for (i = 0; i < num_rx; i++)
+    {
+        rx[i].fd = -1;
+        rx[i].listen_fd = -1;
+        heap[i] = i;
+        num_ready++;
+
+        if (!nmea_stream_init(&rx[i].gen, gen_type, seed + i, 0, 1.0 / rate))
+            goto cleanup;
+        scatter_position(&rx[i]);
+
+        if (open_output(&rx[i], i) == -1)
+            goto cleanup;
+
+        printf("%d %s\n", i, rx[i].name);
+    }
+    fflush(stdout);
+
+    /* like real receivers the epochs start on a whole second */
+    start = (time_us() / 1000000 + 1) * 1000000;
+
+    for (i = 0; i < num_rx; i++)
+    {
+        rx[i].next_epoch = start;
+        if (spread)
+            rx[i].next_epoch += period * i / num_rx;
+        rx[i].due = rx[i].next_epoch;
+        rx[i].gen.utc = rx[i].next_epoch / 1e6;
+    }
+
+    if (out_mode == OUT_TCP)
+    {
+        poll_fds = calloc(num_rx, sizeof(struct pollfd));
+        if (poll_fds == NULL)
+            goto cleanup;
+
+        for (i = 0; i < num_rx; i++)
+        {
+            poll_fds[i].fd = rx[i].listen_fd;
+            poll_fds[i].events = POLLIN;
+        }
+    }
+
+    fprintf(stderr, "Simulating %d receivers at %d Hz, %d baud\n",
+            num_rx, rate, speed);
+
+    next_stats = start + STATS_INTERVAL * 1000000;
+
+    while (keep_running)
+    {
+        now = time_us();
+
+        /* service every receiver that is due */
+        while (rx[heap[0]].due <= now)
+        {
+            service_receiver(&rx[heap[0]], now, period);
+            heap_sift_down(rx, heap, num_rx, 0);
+        }
+
+        if (now >= next_stats)
+        {
+            print_stats((now - start) / 1000000);
+            next_stats += STATS_INTERVAL * 1000000;
+        }
+
+        if (run_time && now >= start + (uint64_t) run_time * 1000000)
+            break;
+
+        /* sleep until the next receiver is due */
+        wait_us = rx[heap[0]].due - time_us();
+        if (wait_us > 100000)
+            wait_us = 100000;
+
+        if (poll_fds != NULL)
+        {
+            /* round up, a timeout of 0 would spin until the deadline */
+            if (poll(poll_fds, num_rx,
+                     wait_us > 0 ? (wait_us + 999) / 1000 : 0) > 0)
+                accept_clients(rx, poll_fds);
+        }
+        else if (wait_us > 0)
+        {
+            usleep(wait_us);
+        }
+    }
+
+    fprintf(stderr, "Shutting down...\n");
+    exit_code = EXIT_SUCCESS;
+
+  cleanup:
+    for (i = 0; i < num_ready; i++)
+    {
+        close_output(&rx[i]);
+        nmea_stream_destroy(&rx[i].gen);
+    }
+
+    if (exit_code == EXIT_SUCCESS)
+        print_stats((time_us() - start) / 1000000);
+
+    free(poll_fds);
+    free(heap);
+    free(rx);
+
+    exit(exit_code);
+}
@@ -6,28 +6,222 @@
  * Simplified BSD License. See license.txt for details.
  *
  */
+#define _GNU_SOURCE             /* accept4(), pthread_setaffinity_np() */
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>           // PRId64 and PRIu64
 #include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include "bcast.h"
 #include "common.h"
+#include "filter.h"
+#include "queue.h"
+#include "spsc.h"
+#include "uring.h"
 
 
-#define NUM_FDS 10
+#define CONN_GPS        0
+#define CONN_LISTEN     1
+#define CONN_CLIENT     2
+#define CONN_WAKE       3
 
-static char    *uart = NULL;    /* UART port */
+/* Slow client policies: what to do when a client queue is full */
+#define SLOW_DROP_OLDEST        0       /* drop oldest queued sentences */
+#define SLOW_DROP_CLIENT        1       /* disconnect the client */
+#define SLOW_LATEST_EPOCH       2       /* keep only the latest epoch */
+
+/* Slots of the broadcast ring */
+#define BCAST_SLOTS     1024
+
+/* Max sentences gathered for one epoch */
+#define MAX_PENDING     64
+
+/* Max events handled per epoll_wait() */
+#define MAX_EVENTS      256
+
+/* Max worker threads and chunks handed to each before it drops them */
+#define MAX_WORKERS     64
+#define HANDOFF_SIZE    4096
+
+/* Max input sources; each may have its own port, plus the shared one */
+#define MAX_SOURCES     32
+#define MAX_STREAMS     (MAX_SOURCES + 1)
+
+/* Longest TAG block with the source name, "\s:name*hh\" */
+#define MAX_TAG         32
+
+/* Longest command line from a client */
+#define MAX_COMMAND     128
+
+/* io_uring: ring size, provided buffers and chunks per async write */
+#define URING_ENTRIES   1024
+#define URING_GPS_BUFS  8       /* per source */
+#define URING_GPS_SIZE  (RDBUF_SIZE - MAX_SENTENCE)
+#define URING_NET_BUFS  256
+#define URING_NET_SIZE  256
+#define URING_IOV       16
+
+/* io_uring: buffer groups and operation in the low bits of user_data */
+#define BGID_GPS        1
+#define BGID_NET        2
+#define OP_READ         0
+#define OP_WRITE        1
+#define OP_ACCEPT       2
+#define OP_OTHER        3
+
+struct worker;
+struct source;
+
+/* One file descriptor of a worker event loop */
+struct conn {
+    int             type;       /* CONN_GPS, CONN_LISTEN, ... */
+    int             fd;         /* -1 once closed */
+    struct worker  *w;          /* worker owning the fd */
+    struct source  *src;        /* source read from, CONN_GPS only */
+    int             stream;     /* stream of a listener or client */
+    int             idx;        /* position in the stream's clients[] */
+    struct sockaddr_in addr;    /* peer address of clients */
+    struct msg_queue queue;     /* output not yet taken by the socket */
+    int             out_armed;  /* EPOLLOUT is in the event mask */
+    struct conn    *next;       /* closed clients waiting to be freed */
+
+    struct filter   filter;     /* sentences the client subscribed to */
+    int             filtered;   /* filter does not pass everything */
+    char            cmd[MAX_COMMAND];   /* command line being received */
+    int             cmd_len;
+
+    int             rate_ms;    /* min time between epochs, 0 for all */
+    uint64_t        due[MAX_SOURCES];   /* next epoch of a source due */
+
+    /* io_uring only */
+    int             inflight;   /* requests not yet completed */
+    int             writing;    /* an async write is in flight */
+    struct iovec    iov[URING_IOV];     /* of the write in flight */
+};
+
+/* Sentences gathered for one stream until the epoch is sent */
+struct batch {
+    struct chunk   *c[MAX_PENDING];
+    int             num;
+};
+
+/* A receiver: UART or pty, file or FIFO, or upstream TCP server.
+ *
+ * Its sentences go to its own port, if any, and with a TAG block naming
+ * the source to the shared port, if any.
+ */
+struct source {
+    struct conn     conn;
+    char           *name;       /* name in the TAG block */
+    char           *dev;        /* device, file:path or tcp:host:port */
+    int             stream;     /* stream of its own port, -1 if none */
+    int             pollable;   /* epoll can watch it, not a plain file */
+    struct framer   frm;
+
+    double          epoch_tod;  /* UTC of current epoch */
+    uint64_t        epoch;      /* number of current epoch */
+    struct batch    own;        /* pending for the own port */
+    struct batch    tagged;     /* pending for the shared port */
+    uint64_t        pending_deadline;   /* send pending at this time */
+
+    char            tag[MAX_TAG];
+    int             tag_len;
+};
+
+/* The epoch a source is in on one stream, kept for rate limited clients
+   until the next one shows that it is whole */
+struct hold {
+    uint64_t        epoch;
+    int             whole;      /* kept from its first sentence on */
+    struct chunk   *c[MAX_PENDING];
+    int             num;
+};
+
+/* Listening socket of one stream and the clients it accepted */
+struct stream {
+    struct conn     listen_conn;
+    struct conn   **clients;    /* connected clients, dense */
+    int             num_clients;
+    int             clients_size;
+    int             accept_paused;      /* listener out of the set */
+    int             num_decimated;      /* clients with a rate limit */
+    struct hold    *holds;      /* per source on the shared stream */
+};
+
+/* An event loop with its share of the clients.
+ *
+ * Without worker threads there is one, run by main() and also reading the
+ * sources. With -t every worker thread has its own listening sockets on
+ * the shared ports, and takes the sentences from the reader through its
+ * handoff ring.
+ */
+struct worker {
+    pthread_t       thread;
+    int             cpu;        /* pinned to this CPU, -1 if not */
+    int             uring;      /* io_uring instead of epoll */
+    int             reads_sources;      /* the sources are read here */
+
+    int             epoll_fd;
+    struct uring    ring;
+    uint8_t        *uring_bufs; /* provided buffers for the sources */
+    uint8_t        *uring_net;  /* provided buffers for the clients */
+
+    struct stream   streams[MAX_STREAMS];
+    struct conn    *closed;     /* freed after each event batch */
+
+    struct spsc     handoff;    /* chunks from the reader */
+    struct conn     wake;       /* eventfd written after a handoff */
+    uint64_t        wake_count; /* io_uring read of the eventfd */
+    uint64_t        handoff_dropped;    /* chunks the ring had no room for */
+
+    uint64_t        msgs_dropped;
+    uint64_t        slow_clients;       /* clients dropped for being slow */
+};
+
+static struct source sources[MAX_SOURCES];
+static char    *source_names[MAX_SOURCES];  /* for filters */
+static int      num_sources = 0;
+static int      open_sources = 0;       /* sources not at EOF yet */
 static int      speed = 4800;   /* serial speed */
-static int      port = 45000;   /* Network port */
-static int      keep_running = 1;
+static int      port = 45000;   /* port of the first source, 0 for none */
+static int      shared_port = 0;        /* port of tagged stream, 0 for none */
+static int      backlog = SOMAXCONN;    /* listen() backlog */
+static int      max_clients = 0;        /* 0 means no limit */
+static size_t   queue_limit = 65536;    /* output queue per client */
+static int      slow_policy = SLOW_DROP_OLDEST;
+static int      check_crc = 0;  /* drop sentences with wrong checksum */
+static char    *filter_text = NULL;     /* filter of new clients */
+static struct filter default_filter;
+static char    *rate_text[MAX_STREAMS];  /* -r options */
+static int      num_rates = 0;
+static int      stream_rate_ms[MAX_STREAMS];    /* rate of new clients */
+static int      use_uring = 0;  /* io_uring instead of epoll */
+static int      num_workers = 0;        /* 0 means a single thread */
+static int      pin_cpus = 0;   /* pin reader and workers to CPUs */
+static volatile int keep_running = 1;
+
+static struct worker *workers = NULL;
+static int      total_clients = 0;      /* of all workers */
+static int      shared_stream;  /* stream number of the tagged stream */
+static struct bcast bcast;      /* data shared by all client queues */
+
+/* Epochs are numbered across all sources, so that the numbers of the
+   tagged stream increase too */
+static uint64_t epoch = 0;
+static int      coalesce_ms = 0;        /* max delay to gather an epoch */
 
 
 void signal_handler(int signo)
@@ -48,14 +242,70 @@ static void help(void)
         "\n Usage: gpsnet [options]\n"
         "\n Possible options are:\n"
         "\n"
-        "  -d dev    Serial device (default is /dev/ttyUSB0).\n"
+        "  -d src    Source [name=]dev, may be given up to 32 times.\n"
+        "            dev is a serial device or pty, file:path for a file\n"
+        "            or FIFO, or tcp:host:port for an upstream server\n"
+        "            (default is /dev/ttyO1, names default to rx1, rx2...).\n"
         "  -s speed  Serial speed (default is 4800 baud).\n"
-        "  -p port   Network port number (default is 45000).\n"
+        "  -p port   Network port of the first source, the next ones\n"
+        "            follow; 0 for none (default is 45000).\n"
+        "  -a port   Network port with the sentences of all sources,\n"
+        "            each with a TAG block naming its source (default\n"
+        "            is 0, none).\n"
+        "  -b num    Backlog of pending connections (default is SOMAXCONN).\n"
+        "  -m num    Maximum number of clients (default is no limit).\n"
+        "  -q bytes  Output queue per client (default is 65536).\n"
+        "  -Q policy Full queue policy: oldest, client or latest\n"
+        "            (default is oldest).\n"
+        "  -c        Drop sentences with a wrong checksum.\n"
+        "  -F filter Only send matching sentences to new clients; a client\n"
+        "            sets its own with a line \"SUB filter\". The filter\n"
+        "            lists addresses like GPGGA, sentence types like RMC,\n"
+        "            talkers like GP, '?' for any character and @name for\n"
+        "            a source, separated by commas (default all).\n"
+        "  -r rate   Send new clients at most rate epochs per second,\n"
+        "            the newest whole one each time; port:rate for one\n"
+        "            port. A client sets its own with a line \"RATE rate\",\n"
+        "            0 for every epoch (default 0).\n"
+        "  -l ms     Gather the sentences of an epoch for up to ms\n"
+        "            milliseconds and send them together (default 0, off).\n"
+        "  -u        Use io_uring instead of epoll when the kernel has it.\n"
+        "  -t num    Serve clients from num worker threads, the sources\n"
+        "            are read by their own thread (default 0, single thread).\n"
+        "  -P        Pin the reader and the workers to one CPU each.\n"
         "  -h        This help message.\n\n";
 
     fprintf(stderr, "%s", help_string);
 }
 
+/* Add a source given as [name=]dev */
+static void add_source(const char *arg)
+{
+    struct source  *src;
+    const char     *eq = strchr(arg, '=');
+    char            name[16];
+
+    if (num_sources == MAX_SOURCES)
+    {
+        fprintf(stderr, "Too many sources, ignoring %s\n", arg);
+        return;
+    }
+
+    src = &sources[num_sources++];
+    src->conn.fd = -1;          /* not opened yet */
+    if (eq != NULL && eq != arg)
+    {
+        src->name = strndup(arg, eq - arg);
+        src->dev = strdup(eq + 1);
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "rx%d", num_sources);
+        src->name = strdup(name);
+        src->dev = strdup(arg);
+    }
+}
+
 /* Parse command line options */
 static void parse_options(int argc, char **argv)
 {
@@ -63,12 +313,13 @@ static void parse_options(int argc, char **argv)
 
     if (argc > 1)
     {
-        while ((option = getopt(argc, argv, "d:s:p:h")) != -1)
+        while ((option =
+                getopt(argc, argv, "d:s:p:a:b:m:q:Q:cF:r:l:ut:Ph")) != -1)
         {
             switch (option)
             {
             case 'd':
-                uart = strdup(optarg);
+                add_source(optarg);
                 break;
 
             case 's':
@@ -79,6 +330,64 @@ static void parse_options(int argc, char **argv)
                 port = atoi(optarg);
                 break;
 
+            case 'a':
+                shared_port = atoi(optarg);
+                break;
+
+            case 'b':
+                backlog = atoi(optarg);
+                break;
+
+            case 'm':
+                max_clients = atoi(optarg);
+                break;
+
+            case 'q':
+                queue_limit = atoi(optarg);
+                break;
+
+            case 'Q':
+                if (strcmp(optarg, "client") == 0)
+                    slow_policy = SLOW_DROP_CLIENT;
+                else if (strcmp(optarg, "latest") == 0)
+                    slow_policy = SLOW_LATEST_EPOCH;
+                else
+                    slow_policy = SLOW_DROP_OLDEST;
+                break;
+
+            case 'c':
+                check_crc = 1;
+                break;
+
+            case 'F':
+                filter_text = strdup(optarg);
+                break;
+
+            case 'r':
+                if (num_rates < MAX_STREAMS)
+                    rate_text[num_rates++] = strdup(optarg);
+                break;
+
+            case 'l':
+                coalesce_ms = atoi(optarg);
+                break;
+
+            case 'u':
+                use_uring = 1;
+                break;
+
+            case 't':
+                num_workers = atoi(optarg);
+                if (num_workers < 0)
+                    num_workers = 0;
+                if (num_workers > MAX_WORKERS)
+                    num_workers = MAX_WORKERS;
+                break;
+
+            case 'P':
+                pin_cpus = 1;
+                break;
+
             case 'h':
                 help();
                 exit(EXIT_SUCCESS);
@@ -91,228 +400,1611 @@ static void parse_options(int argc, char **argv)
     }
 }
 
-/* send GPS data to active network sockets */
-static void send_gps_data(struct xfr_buf *gps_buf, struct pollfd *poll_fds,
-                          int num_fd)
+/* Convert epochs per second to the time between them, 0 for all */
+static int rate_to_ms(double rate)
 {
-    int             i;
-    ssize_t         written;
+    return rate > 0.0 ? (int)(1000.0 / rate + 0.5) : 0;
+}
+
+/* Set the rate of new clients from -r rate or -r port:rate.
+ * Returns -1 if there is no such port.
+ */
+static int parse_rate(const char *text)
+{
+    const char     *colon = strchr(text, ':');
+    int             rate_ms, rate_port, i;
+
+    if (colon == NULL)
+    {
+        rate_ms = rate_to_ms(atof(text));
+        for (i = 0; i < MAX_STREAMS; i++)
+            stream_rate_ms[i] = rate_ms;
+        return 0;
+    }
+
+    rate_ms = rate_to_ms(atof(colon + 1));
+    rate_port = atoi(text);
+
+    if (shared_port > 0 && rate_port == shared_port)
+    {
+        stream_rate_ms[shared_stream] = rate_ms;
+        return 0;
+    }
 
-    for (i = 2; i < num_fd; i++)
+    for (i = 0; i < num_sources; i++)
     {
-        if (poll_fds[i].fd != -1)
+        if (port > 0 && rate_port == port + i)
         {
-            written = write(poll_fds[i].fd, gps_buf->data, gps_buf->wridx);
-            if (written != gps_buf->wridx)
-                fprintf(stderr, "Wrote %zd instead of %d bytes to FD=%d\n",
-                        written, gps_buf->wridx, poll_fds[i].fd);
+            stream_rate_ms[i] = rate_ms;
+            return 0;
         }
     }
+
+    fprintf(stderr, "No port %d for rate %s\n", rate_port, text);
+    return -1;
 }
 
-/* get index of first available fd */
-static int get_idle_fd_index(struct pollfd *poll_fds, int num_fd)
+/* Open a source and set up its framer and TAG block.
+ * Returns -1 on error.
+ */
+static int open_source(struct source *src, int idx)
 {
+    char           *host, *colon;
+    uint8_t         cs = 0;
     int             i;
 
-    for (i = 2; i < NUM_FDS; i++)
+    if (strncmp(src->dev, "tcp:", 4) == 0)
+    {
+        host = strdup(src->dev + 4);
+        colon = strrchr(host, ':');
+        if (colon == NULL)
+        {
+            fprintf(stderr, "Source %s: missing port\n", src->dev);
+            free(host);
+            return -1;
+        }
+        *colon = '\0';
+        src->conn.fd = tcp_connect(host, atoi(colon + 1));
+        free(host);
+    }
+    else if (strncmp(src->dev, "file:", 5) == 0)
     {
-        if (poll_fds[i].fd == -1)
-            return i;
+        src->conn.fd = open(src->dev + 5, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (src->conn.fd == -1)
+            fprintf(stderr, "Error opening %s: %d: %s\n", src->dev + 5,
+                    errno, strerror(errno));
+    }
+    else
+    {
+        src->conn.fd = gps_open(src->dev, speed, 0);
     }
 
-    return -1;
+    if (src->conn.fd == -1)
+        return -1;
+
+    src->conn.type = CONN_GPS;
+    src->conn.src = src;
+    src->pollable = 1;
+    src->stream = port > 0 ? idx : -1;
+    src->epoch_tod = -1.0;
+    framer_init(&src->frm, check_crc);
+
+    /* NMEA 0183 TAG block, source identification */
+    src->tag_len = snprintf(src->tag, sizeof(src->tag), "\\s:%.20s*",
+                            src->name);
+    for (i = 1; i < src->tag_len - 1; i++)
+        cs ^= src->tag[i];
+    src->tag_len += snprintf(src->tag + src->tag_len,
+                             sizeof(src->tag) - src->tag_len, "%02X\\", cs);
+
+    open_sources++;
+
+    return 0;
 }
 
-int main(int argc, char **argv)
+/* A source is at its end; the server stops with the last one */
+static void close_source(struct source *src)
 {
-    int             exit_code = EXIT_FAILURE;
-    int             sock_fd, gps_fd;
-    struct sockaddr_in serv_addr, cli_addr;
-    socklen_t       cli_addr_len;
+    fprintf(stderr, "Got EOF from %s (%s)!\n", src->name, src->dev);
 
-    struct pollfd   poll_fds[NUM_FDS];
-    int             i;
+    /* closing the fd also removes it from the epoll set */
+    close(src->conn.fd);
+    src->conn.fd = -1;
 
-    struct xfr_buf  gps_buf, net_buf;
+    if (--open_sources == 0)
+        keep_running = 0;
+}
 
-    gps_buf.wridx = 0;
-    gps_buf.valid_pkts = 0;
-    gps_buf.invalid_pkts = 0;
+/* Pin the calling thread to a CPU, counted modulo the online CPUs */
+static void pin_thread(int cpu)
+{
+    cpu_set_t       set;
+    long            ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int             err;
 
-    net_buf.wridx = 0;
-    net_buf.valid_pkts = 0;
-    net_buf.invalid_pkts = 0;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % (ncpu > 0 ? ncpu : 1), &set);
 
-    parse_options(argc, argv);
+    err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+        fprintf(stderr, "Can't pin thread to CPU %d: %d: %s\n", cpu, err,
+                strerror(err));
+}
 
-    /* setup signal handler */
-    if (signal(SIGINT, signal_handler) == SIG_ERR)
-        printf("Warning: Can't catch SIGINT\n");
-    if (signal(SIGTERM, signal_handler) == SIG_ERR)
-        printf("Warning: Can't catch SIGTERM\n");
+/* Add or change a file descriptor in the epoll set */
+static int watch_fd(int op, struct conn *conn, uint32_t events)
+{
+    struct epoll_event ev;
 
-    /* open GPS port */
-    if (uart == NULL)
-        uart = strdup("/dev/ttyO1");
-    gps_fd = gps_open(uart, speed, 0);
-    if (gps_fd == -1)
-        exit(EXIT_FAILURE);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = conn;
 
-    /* open and configure network interface */
-    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_fd == -1)
+    if (epoll_ctl(conn->w->epoll_fd, op, conn->fd, &ev) == -1)
     {
-        fprintf(stderr, "Error creating socket: %d: %s\n", errno,
-                strerror(errno));
-        goto cleanup;
+        fprintf(stderr, "epoll_ctl() error on FD %d: %d: %s\n", conn->fd,
+                errno, strerror(errno));
+        return -1;
     }
 
-    int             yes = 1;
+    return 0;
+}
 
-    if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == -1)
-        fprintf(stderr, "Error setting SO_REUSEADDR: %d: %s\n", errno,
-                strerror(errno));
+/* io_uring: give buffer bid of a group back to the kernel */
+static void uring_provide(struct worker *w, int bgid, int bid)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(&w->ring);
+    int             size = bgid == BGID_GPS ? URING_GPS_SIZE : URING_NET_SIZE;
+    uint8_t        *base = bgid == BGID_GPS ? w->uring_bufs : w->uring_net;
+
+    if (sqe == NULL)
+        return;
+
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = 1;
+    sqe->addr = (uintptr_t) (base + bid * size);
+    sqe->len = size;
+    sqe->off = bid;
+    sqe->buf_group = bgid;
+    sqe->user_data = OP_OTHER;
+}
+
+/* io_uring: accept connections on a stream until cancelled */
+static void uring_accept(struct worker *w, struct conn *listen_conn)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(&w->ring);
 
-    /* bind socket to host address */
-    memset(&serv_addr, 0, sizeof(struct sockaddr_in));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_addr.s_addr = INADDR_ANY;
-    serv_addr.sin_port = htons(port);
-    if (bind(sock_fd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) == -1)
+    if (sqe == NULL)
+        return;
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_conn->fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = (uintptr_t) listen_conn | OP_ACCEPT;
+}
+
+/* io_uring: read from a source or the wake eventfd, or receive from a
+   client until it closes */
+static void uring_read(struct conn *conn)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(&conn->w->ring);
+
+    if (sqe == NULL)
+        return;
+
+    sqe->fd = conn->fd;
+    sqe->user_data = (uintptr_t) conn | OP_READ;
+
+    switch (conn->type)
     {
-        fprintf(stderr, "bind() error: %d: %s\n", errno, strerror(errno));
-        goto cleanup;
+    case CONN_GPS:
+        sqe->opcode = IORING_OP_READ;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->off = -1;
+        sqe->len = URING_GPS_SIZE;
+        sqe->buf_group = BGID_GPS;
+        break;
+
+    case CONN_WAKE:
+        sqe->opcode = IORING_OP_READ;
+        sqe->off = -1;
+        sqe->addr = (uintptr_t) & conn->w->wake_count;
+        sqe->len = sizeof(uint64_t);
+        break;
+
+    default:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->buf_group = BGID_NET;
+        break;
     }
 
-    if (listen(sock_fd, 1) == -1)
+    conn->inflight++;
+}
+
+/* io_uring: write the front of the client queue, one write at a time */
+static void uring_write(struct conn *conn)
+{
+    struct io_uring_sqe *sqe;
+    int             num;
+
+    if (conn->writing || conn->fd == -1 || conn->queue.count == 0)
+        return;
+
+    sqe = uring_get_sqe(&conn->w->ring);
+    if (sqe == NULL)
+        return;
+
+    num = queue_iov(&conn->queue, conn->iov, URING_IOV);
+    conn->queue.locked = num;
+
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = conn->fd;
+    sqe->addr = (uintptr_t) conn->iov;
+    sqe->len = num;
+    sqe->off = -1;
+    sqe->user_data = (uintptr_t) conn | OP_WRITE;
+
+    conn->writing = 1;
+    conn->inflight++;
+}
+
+/* Set the rate limit of a client, 0 for none */
+static void set_rate(struct conn *conn, int rate_ms)
+{
+    struct stream  *st = &conn->w->streams[conn->stream];
+
+    st->num_decimated += (rate_ms > 0) - (conn->rate_ms > 0);
+    conn->rate_ms = rate_ms;
+    memset(conn->due, 0, sizeof(conn->due));
+}
+
+/* Close a client connection.
+ * The conn struct and its queue are only freed by free_closed() after the
+ * current event batch, since later events of the batch may still point to
+ * it.
+ */
+static void close_client(struct conn *conn)
+{
+    struct worker  *w = conn->w;
+    struct stream  *st = &w->streams[conn->stream];
+    struct conn    *last;
+
+    if (conn->fd == -1)
+        return;
+
+    fprintf(stderr, "Connection closed (FD=%d), %" PRIu64
+            " messages dropped\n", conn->fd, conn->queue.dropped);
+
+    w->msgs_dropped += conn->queue.dropped;
+    set_rate(conn, 0);
+
+    /* io_uring requests hold the socket open, shutdown ends them */
+    if (w->uring)
+        shutdown(conn->fd, SHUT_RDWR);
+
+    /* closing the fd also removes it from the epoll set */
+    close(conn->fd);
+    conn->fd = -1;
+
+    last = st->clients[--st->num_clients];
+    st->clients[conn->idx] = last;
+    last->idx = conn->idx;
+    __atomic_sub_fetch(&total_clients, 1, __ATOMIC_RELAXED);
+
+    conn->next = w->closed;
+    w->closed = conn;
+
+    if (st->accept_paused && w->uring)
     {
-        fprintf(stderr, "listen() error: %d: %s\n", errno, strerror(errno));
-        goto cleanup;
+        uring_accept(w, &st->listen_conn);
+        st->accept_paused = 0;
+    }
+    else if (st->accept_paused &&
+             watch_fd(EPOLL_CTL_ADD, &st->listen_conn, EPOLLIN) == 0)
+        st->accept_paused = 0;
+}
+
+/* Free closed clients, except those with io_uring requests in flight
+   unless all is torn down */
+static void free_closed(struct worker *w, int all)
+{
+    struct conn    *conn;
+    struct conn   **link = &w->closed;
+
+    while (*link != NULL)
+    {
+        conn = *link;
+        if (conn->inflight > 0 && !all)
+        {
+            link = &conn->next;
+            continue;
+        }
+        *link = conn->next;
+        /* an io_uring write may have used the queued chunks until now */
+        queue_free(&conn->queue);
+        free(conn);
+    }
+}
+
+/* Add a new client to the table of its stream and the epoll set */
+static int add_client(struct worker *w, int stream, int fd,
+                      const struct sockaddr_in *addr)
+{
+    struct stream  *st = &w->streams[stream];
+    struct conn    *conn;
+    struct conn   **table;
+    int             size;
+
+    if (st->num_clients == st->clients_size)
+    {
+        size = st->clients_size ? 2 * st->clients_size : 64;
+        table = realloc(st->clients, size * sizeof(struct conn *));
+        if (table == NULL)
+            return -1;
+        st->clients = table;
+        st->clients_size = size;
     }
 
-    memset(&cli_addr, 0, sizeof(struct sockaddr_in));
-    cli_addr_len = sizeof(cli_addr);
+    conn = calloc(1, sizeof(struct conn));
+    if (conn == NULL)
+        return -1;
 
+    conn->type = CONN_CLIENT;
+    conn->fd = fd;
+    conn->w = w;
+    conn->stream = stream;
+    conn->idx = st->num_clients;
+    conn->addr = *addr;
+    conn->filter = default_filter;
+    conn->filtered = default_filter.num > 0 || default_filter.sources != ~0u;
+    queue_init(&conn->queue, queue_limit);
+    set_rate(conn, stream_rate_ms[stream]);
+
+    if (w->uring)
+        uring_read(conn);
+    else if (watch_fd(EPOLL_CTL_ADD, conn, EPOLLIN) == -1)
+    {
+        free(conn);
+        return -1;
+    }
 
-    /* GPS input */
-    poll_fds[0].fd = gps_fd;
-    poll_fds[0].events = POLLIN;
+    st->clients[st->num_clients++] = conn;
+    __atomic_add_fetch(&total_clients, 1, __ATOMIC_RELAXED);
 
-    /* network socket (listening for connections) */
-    poll_fds[1].fd = sock_fd;
-    poll_fds[1].events = POLLIN;
+    return 0;
+}
 
-    /* network sockets to clients (when connected) */
-    for (i = 2; i < NUM_FDS; i++)
-        poll_fds[i].fd = -1;
+/* Take a new connection unless there are too many */
+static void new_client(struct worker *w, int stream, int fd,
+                       const struct sockaddr_in *addr)
+{
+    int             num = __atomic_load_n(&total_clients, __ATOMIC_RELAXED);
 
+    fprintf(stderr, "New connection from %s\n", inet_ntoa(addr->sin_addr));
 
-    while (keep_running)
+    if (max_clients > 0 && num >= max_clients)
     {
-        if (poll(poll_fds, NUM_FDS, 100) < 0)
-            continue;
+        fprintf(stderr, "Connection refused: %d clients connected\n", num);
+        close(fd);
+    }
+    else if (add_client(w, stream, fd, addr) == -1)
+    {
+        fprintf(stderr, "Connection refused: can't add FD=%d\n", fd);
+        close(fd);
+    }
+    else
+    {
+        fprintf(stderr, "Connection accepted (FD=%d)\n", fd);
+    }
+}
 
-        /* service network clients */
-        for (i = 2; i < NUM_FDS; i++)
+/* Accept all pending connections of a stream */
+static void accept_clients(struct conn *listen_conn)
+{
+    struct worker  *w = listen_conn->w;
+    struct sockaddr_in cli_addr;
+    socklen_t       cli_addr_len;
+    int             new;
+
+    while (1)
+    {
+        cli_addr_len = sizeof(cli_addr);
+        new = accept4(listen_conn->fd, (struct sockaddr *)&cli_addr,
+                      &cli_addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (new == -1)
         {
-            if ((poll_fds[i].fd != -1) && (poll_fds[i].revents & POLLIN))
-            {
-                switch (read_data(poll_fds[i].fd, &net_buf))
-                {
-                case MSG_TYPE_EOF:
-                    fprintf(stderr, "Connection closed (FD=%d)\n",
-                            poll_fds[i].fd);
-                    close(poll_fds[i].fd);
-                    poll_fds[i].fd = -1;
-                    poll_fds[i].events = 0;
-                    break;
-                }
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
 
-                net_buf.wridx = 0;
-            }
+            fprintf(stderr, "accept() error: %d: %s\n", errno,
+                    strerror(errno));
+
+            /* out of descriptors: stop polling the listener until a
+               client goes away, or the loop would spin on it */
+            if ((errno == EMFILE || errno == ENFILE) &&
+                epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, listen_conn->fd,
+                          NULL) == 0)
+                w->streams[listen_conn->stream].accept_paused = 1;
+            break;
         }
 
-        /* check if there are any new connections pending */
-        if (poll_fds[1].revents & POLLIN)
-        {
-            int             new;
-            int             fd_idx = -1;
+        new_client(w, listen_conn->stream, new, &cli_addr);
+    }
+}
 
-            new = accept(sock_fd, (struct sockaddr *)&cli_addr, &cli_addr_len);
-            if (new == -1)
-            {
-                fprintf(stderr, "accept() error: %d: %s\n", errno,
-                        strerror(errno));
-                goto cleanup;
-            }
+/* Watch for room in the socket while the client has queued output */
+static void arm_output(struct conn *conn, int on)
+{
+    if (conn->out_armed == on)
+        return;
 
-            fprintf(stderr, "New connection from %s\n",
-                    inet_ntoa(cli_addr.sin_addr));
+    if (watch_fd(EPOLL_CTL_MOD, conn, on ? EPOLLIN | EPOLLOUT : EPOLLIN) == 0)
+        conn->out_armed = on;
+}
 
-            if ((fd_idx = get_idle_fd_index(&poll_fds[0], NUM_FDS)) > 1)
-            {
-                fprintf(stderr, "Connection accepted (FD=%d)\n", new);
-                poll_fds[fd_idx].fd = new;
-                poll_fds[fd_idx].events = POLLIN;
-            }
-            else
-            {
-                fprintf(stderr, "Connection refused. Got fd_idx = %d\n",
-                        fd_idx);
-                close(new);
-            }
-        }
+/* Queue data the socket did not take, applying the slow client policy.
+ * Returns -1 if the client was closed.
+ */
+static int queue_data(struct conn *conn, struct chunk *c, int sent)
+{
+    struct msg_queue *q = &conn->queue;
 
-        /* read data from gps */
-        if (poll_fds[0].revents & POLLIN)
+    if (q->bytes + c->len - sent > q->limit)
+    {
+        switch (slow_policy)
         {
-            switch (read_data(poll_fds[0].fd, &gps_buf))
-            {
-            case MSG_TYPE_INVALID:
-                gps_buf.invalid_pkts++;
-                gps_buf.wridx = 0;
-                break;
+        case SLOW_DROP_CLIENT:
+            fprintf(stderr, "Slow client %s (FD=%d), disconnecting\n",
+                    inet_ntoa(conn->addr.sin_addr), conn->fd);
+            conn->w->slow_clients++;
+            close_client(conn);
+            return -1;
 
-            case MSG_TYPE_INCOMPLETE:
-                break;
+        case SLOW_LATEST_EPOCH:
+            queue_drop_epochs(q, c->source, c->epoch);
+            /* the latest epoch alone may still not fit */
+            queue_drop_oldest(q, c->len - sent);
+            break;
 
-            case MSG_TYPE_VALID:
-                send_gps_data(&gps_buf, &poll_fds[0], NUM_FDS);
-#if DEBUG
-                gps_buf.data[gps_buf.wridx] = 0;
-                fprintf(stderr, "Valid GPS data: %s", gps_buf.data);
-#endif
-                gps_buf.valid_pkts++;
-                gps_buf.wridx = 0;
-                break;
+        default:
+            queue_drop_oldest(q, c->len - sent);
+            break;
+        }
+    }
 
-            case MSG_TYPE_EOF:
-                fprintf(stderr, "Got EOF from GPS!\n");
-                gps_buf.wridx = 0;
-                keep_running = 0;
-                break;
+    if (queue_push(q, c, sent) == -1)
+    {
+        q->dropped++;
+        return 0;
+    }
 
-            default:
-                fprintf(stderr, "WTF?\n");
-                gps_buf.wridx = 0;
-                break;
-            }
+    if (conn->w->uring)
+        uring_write(conn);
+    else
+        arm_output(conn, 1);
+
+    return 0;
+}
+
+/* send chunks to one client in one writev(), queue what it doesn't take */
+static void send_client(struct conn *conn, struct chunk **c,
+                        const struct iovec *iov, int num, ssize_t want)
+{
+    ssize_t         written;
+    int             j;
+
+    /* keep the order: after queued data, behind it; io_uring
+       writes all through the queue */
+    if (conn->queue.count > 0 || conn->w->uring)
+    {
+        for (j = 0; j < num && queue_data(conn, c[j], 0) == 0; j++) ;
+        return;
+    }
+
+    written = (num == 1) ? write(conn->fd, c[0]->data, c[0]->len) :
+        writev(conn->fd, iov, num);
+    if (written == want)
+        return;
+
+    if (written == -1)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            close_client(conn);
+            return;
         }
+        written = 0;
+    }
+
+    /* queue the rest, starting with the chunk written in part */
+    for (j = 0; written >= c[j]->len; j++)
+        written -= c[j]->len;
 
-        //usleep(10000);
+    if (queue_data(conn, c[j], written) == 0)
+        for (j++; j < num && queue_data(conn, c[j], 0) == 0; j++) ;
+}
+
+/* send chunks to one client, only those it subscribed to */
+static void send_filtered(struct conn *conn, struct chunk **c,
+                          const struct iovec *iov, int num, ssize_t want)
+{
+    struct iovec    sel_iov[MAX_PENDING];
+    struct chunk   *sel[MAX_PENDING];
+    ssize_t         sel_want = 0;
+    int             j, n = 0;
+
+    if (!conn->filtered)
+    {
+        send_client(conn, c, iov, num, want);
+        return;
     }
 
-    fprintf(stderr, "Shutting down...\n");
-    exit_code = EXIT_SUCCESS;
+    for (j = 0; j < num; j++)
+    {
+        if (!filter_match(&conn->filter, c[j]))
+            continue;
+        sel[n] = c[j];
+        sel_iov[n] = iov[j];
+        sel_want += c[j]->len;
+        n++;
+    }
 
-  cleanup:
-    for (i = 0; i < NUM_FDS; i++)
-        if (poll_fds[i].fd != -1)
-            close(poll_fds[i].fd);
+    if (n > 0)
+        send_client(conn, sel, sel_iov, n, sel_want);
+}
+
+/* describe chunks for writev(), returns the bytes */
+static ssize_t chunk_iov(struct chunk **c, int num, struct iovec *iov)
+{
+    ssize_t         want = 0;
+    int             j;
+
+    for (j = 0; j < num; j++)
+    {
+        iov[j].iov_base = c[j]->data;
+        iov[j].iov_len = c[j]->len;
+        want += c[j]->len;
+    }
+
+    return want;
+}
+
+static void hold_clear(struct hold *h)
+{
+    int             j;
+
+    for (j = 0; j < h->num; j++)
+        chunk_put(h->c[j]);
+    h->num = 0;
+}
+
+/* Send a whole epoch to the rate limited clients it is due for. The time
+ * of the next one is kept on a grid, so that jitter of the receiver does
+ * not make the rate drift, unless the client fell behind by a period.
+ */
+static void release_epoch(struct stream *st, struct hold *h)
+{
+    struct iovec    iov[MAX_PENDING];
+    struct conn    *conn;
+    uint64_t        now = time_mono_ms();
+    uint64_t       *due;
+    ssize_t         want;
+    int             i;
+
+    want = chunk_iov(h->c, h->num, iov);
+
+    for (i = st->num_clients - 1; i >= 0; i--)
+    {
+        conn = st->clients[i];
+        due = &conn->due[h->c[0]->source];
+        if (conn->rate_ms == 0 || now < *due)
+            continue;
+
+        *due += conn->rate_ms;
+        if (*due <= now)
+            *due = now + conn->rate_ms;
+
+        send_filtered(conn, h->c, iov, h->num, want);
+    }
+}
+
+/* Keep the sentences of the current epochs for the rate limited clients;
+ * the first sentence of a new epoch completes the one before.
+ */
+static void hold_chunks(int stream, struct stream *st, struct chunk **c,
+                        int num)
+{
+    struct hold    *h;
+    int             j;
+
+    for (j = 0; j < num; j++)
+    {
+        h = &st->holds[stream == shared_stream ? c[j]->source : 0];
+
+        if (c[j]->epoch != h->epoch)
+        {
+            if (h->whole && h->num > 0)
+                release_epoch(st, h);
+            hold_clear(h);
+            h->epoch = c[j]->epoch;
+            h->whole = st->num_decimated > 0;
+        }
+
+        if (!h->whole)
+            continue;
+
+        /* an epoch too long to keep is skipped */
+        if (h->num == MAX_PENDING)
+        {
+            hold_clear(h);
+            h->whole = 0;
+            continue;
+        }
+
+        chunk_get(c[j]);
+        h->c[h->num++] = c[j];
+    }
+}
+
+/* send GPS data to the clients of a stream */
+static void fan_out(struct worker *w, int stream, struct chunk **c, int num)
+{
+    struct stream  *st = &w->streams[stream];
+    struct iovec    iov[MAX_PENDING];
+    struct conn    *conn;
+    ssize_t         want;
+    int             i;
+
+    if (st->holds != NULL)
+        hold_chunks(stream, st, c, num);
+
+    want = chunk_iov(c, num, iov);
+
+    /* backwards, so that closing a client only moves one already served */
+    for (i = st->num_clients - 1; i >= 0; i--)
+    {
+        conn = st->clients[i];
+        if (conn->rate_ms == 0)
+            send_filtered(conn, c, iov, num, want);
+    }
+}
+
+/* send chunks of mixed streams, each run of one stream in one go */
+static void fan_out_runs(struct worker *w, struct chunk **c, int num)
+{
+    int             first, j;
+
+    for (first = 0; first < num; first = j)
+    {
+        for (j = first + 1; j < num && c[j]->stream == c[first]->stream;
+             j++) ;
+        fan_out(w, c[first]->stream, c + first, j - first);
+    }
+}
+
+/* Hand chunks to every worker thread and wake them up. A worker that
+ * fell behind by a whole handoff ring loses the chunks that do not fit.
+ */
+static void hand_off(struct chunk **c, int num)
+{
+    struct worker  *w;
+    uint64_t        one = 1;
+    int             i, j;
+
+    for (j = 0; j < num; j++)
+        chunk_get_n(c[j], num_workers);
+
+    for (i = 0; i < num_workers; i++)
+    {
+        w = &workers[i];
+        for (j = 0; j < num; j++)
+        {
+            if (spsc_push(&w->handoff, c[j]) == -1)
+            {
+                chunk_put(c[j]);
+                w->handoff_dropped++;
+            }
+        }
+
+        if (write(w->wake.fd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            fprintf(stderr, "Error waking worker %d: %d: %s\n", i, errno,
+                    strerror(errno));
+    }
+}
+
+/* send GPS data of one stream to the clients, directly or through the
+   workers */
+static void send_gps_data(int stream, struct chunk **c, int num)
+{
+    if (num_workers > 0)
+        hand_off(c, num);
+    else
+        fan_out(&workers[0], stream, c, num);
+}
+
+/* worker: send the chunks handed over by the reader */
+static void take_handoff(struct worker *w)
+{
+    struct chunk   *c[MAX_PENDING];
+    int             j, num;
+
+    do
+    {
+        for (num = 0; num < MAX_PENDING; num++)
+            if ((c[num] = spsc_pop(&w->handoff)) == NULL)
+                break;
+
+        if (num > 0)
+            fan_out_runs(w, c, num);
+
+        for (j = 0; j < num; j++)
+            chunk_put(c[j]);
+    }
+    while (num == MAX_PENDING);
+}
+
+/* socket has room again */
+static void write_client(struct conn *conn)
+{
+    switch (queue_flush(&conn->queue, conn->fd))
+    {
+    case 0:
+        arm_output(conn, 0);
+        break;
+
+    case -1:
+        close_client(conn);
+        break;
+    }
+}
+
+/* Start a new epoch when the UTC of the receiver changes.
+ * Returns 1 if the sentence starts a new epoch.
+ */
+static int update_epoch(struct source *src, const uint8_t * line, int len)
+{
+    double          tod;
+
+    if (sentence_time((const char *)line, len, &tod) && tod != src->epoch_tod)
+    {
+        src->epoch_tod = tod;
+        src->epoch = ++epoch;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* send the gathered sentences of one stream */
+static void flush_batch(int stream, struct batch *b)
+{
+    int             i;
+
+    if (b->num == 0)
+        return;
+
+    send_gps_data(stream, b->c, b->num);
+
+    for (i = 0; i < b->num; i++)
+        chunk_put(b->c[i]);
+    b->num = 0;
+}
+
+/* send the sentences gathered for the current epoch of a source */
+static void flush_pending(struct source *src)
+{
+    flush_batch(src->stream, &src->own);
+    flush_batch(shared_stream, &src->tagged);
+}
+
+/* Send a new chunk to a stream or gather it for the epoch; the publisher
+   reference goes with it */
+static void send_chunk(struct source *src, int stream, struct batch *b,
+                       struct chunk *chunk, uint64_t addr)
+{
+    chunk->stream = stream;
+    chunk->source = src - sources;
+    chunk->addr = addr;
+
+    if (coalesce_ms > 0)
+    {
+        if (src->own.num == 0 && src->tagged.num == 0)
+            src->pending_deadline = time_mono_ms() + coalesce_ms;
+        b->c[b->num++] = chunk;
+        if (b->num == MAX_PENDING)
+            flush_pending(src);
+    }
+    else
+    {
+        send_gps_data(stream, &chunk, 1);
+        chunk_put(chunk);
+    }
+}
+
+/* send every whole sentence in the framer of a source to the clients */
+static void publish_sentences(struct source *src)
+{
+    struct chunk   *chunk;
+    const uint8_t  *line;
+    uint8_t         tagged[MAX_TAG + MAX_SENTENCE];
+    uint64_t        addr;
+    int             len;
+
+    while (framer_next(&src->frm, &line, &len) == MSG_TYPE_VALID)
+    {
+        if (update_epoch(src, line, len))
+            flush_pending(src);
+
+        addr = filter_address(line, len);
+
+        if (src->stream >= 0)
+        {
+            chunk = bcast_publish(&bcast, line, len, src->epoch);
+            if (chunk != NULL)
+                send_chunk(src, src->stream, &src->own, chunk, addr);
+        }
+
+        if (shared_port > 0)
+        {
+            memcpy(tagged, src->tag, src->tag_len);
+            memcpy(tagged + src->tag_len, line, len);
+            chunk = bcast_publish(&bcast, tagged, src->tag_len + len,
+                                  src->epoch);
+            if (chunk != NULL)
+                send_chunk(src, shared_stream, &src->tagged, chunk, addr);
+        }
+#if DEBUG
+        fprintf(stderr, "Valid GPS data from %s: %.*s", src->name, len, line);
+#endif
+    }
+}
+
+/* read data from a source and send every whole sentence to the clients */
+static void read_gps(struct source *src)
+{
+    switch (framer_read(&src->frm, src->conn.fd))
+    {
+    case MSG_TYPE_EOF:
+        flush_pending(src);
+        close_source(src);
+        return;
+
+    case MSG_TYPE_INVALID:
+        return;
+    }
+
+    publish_sentences(src);
+}
+
+/* Set the filter of a client from a "SUB filter" line, or its rate
+   limit from "RATE rate"; other lines are ignored */
+static void client_command(struct conn *conn, char *line)
+{
+    struct filter   f;
+
+    if (strncasecmp(line, "RATE", 4) == 0 &&
+        (line[4] == '\0' || line[4] == ' ' || line[4] == '\t'))
+    {
+        set_rate(conn, rate_to_ms(atof(line + 4)));
+        fprintf(stderr, "Rate of FD=%d: %d ms\n", conn->fd, conn->rate_ms);
+        return;
+    }
+
+    if (strncasecmp(line, "SUB", 3) != 0 ||
+        (line[3] != '\0' && line[3] != ' ' && line[3] != '\t'))
+        return;
+
+    if (filter_parse(&f, line + 3, source_names, num_sources) == -1)
+    {
+        fprintf(stderr, "Bad filter from FD=%d: %s\n", conn->fd, line + 3);
+        return;
+    }
+
+    conn->filter = f;
+    conn->filtered = f.num > 0 || f.sources != ~0u;
+    fprintf(stderr, "Filter of FD=%d:%s\n", conn->fd, line + 3);
+}
+
+/* gather command lines from a client, a line too long is dropped */
+static void client_input(struct conn *conn, const uint8_t * data, int len)
+{
+    int             i;
+
+    for (i = 0; i < len; i++)
+    {
+        if (data[i] == '\n' || data[i] == '\r')
+        {
+            if (conn->cmd_len > 0 && conn->cmd_len < MAX_COMMAND)
+            {
+                conn->cmd[conn->cmd_len] = '\0';
+                client_command(conn, conn->cmd);
+            }
+            conn->cmd_len = 0;
+        }
+        else if (conn->cmd_len < MAX_COMMAND)
+        {
+            conn->cmd[conn->cmd_len++] = data[i];
+        }
+    }
+}
+
+/* service a network client; they may send subscription commands */
+static void read_client(struct conn *conn)
+{
+    uint8_t         buf[512];
+    ssize_t         num;
+
+    num = read(conn->fd, buf, sizeof(buf));
+    if (num > 0)
+        client_input(conn, buf, num);
+    else if (num == 0 || (errno != EAGAIN && errno != EINTR))
+        close_client(conn);
+}
+
+/* wait time until the first pending sentences are due */
+static int pending_timeout(void)
+{
+    uint64_t        now = 0;
+    int             i, timeout = 100;
+
+    for (i = 0; i < num_sources; i++)
+    {
+        if (sources[i].own.num == 0 && sources[i].tagged.num == 0)
+            continue;
+        if (now == 0)
+            now = time_mono_ms();
+        if (sources[i].pending_deadline <= now)
+            return 0;
+        if (sources[i].pending_deadline - now < (uint64_t) timeout)
+            timeout = sources[i].pending_deadline - now;
+    }
+
+    return timeout;
+}
+
+/* send the pending sentences that are due */
+static void flush_due(void)
+{
+    uint64_t        now = time_mono_ms();
+    int             i;
+
+    for (i = 0; i < num_sources; i++)
+        if (sources[i].pending_deadline <= now)
+            flush_pending(&sources[i]);
+}
+
+/* read the open sources epoll can't watch, plain files are always ready */
+static int read_unpollable(void)
+{
+    int             i, num = 0;
+
+    for (i = 0; i < num_sources; i++)
+    {
+        if (sources[i].pollable || sources[i].conn.fd == -1)
+            continue;
+        read_gps(&sources[i]);
+        num++;
+    }
+
+    return num;
+}
+
+static void epoll_loop(struct worker *w)
+{
+    struct epoll_event events[MAX_EVENTS];
+    struct conn    *conn;
+    uint64_t        count;
+    int             i, num, busy = 0;
+
+    while (keep_running)
+    {
+        /* the pending sentences belong to the loop reading the sources */
+        num = epoll_wait(w->epoll_fd, events, MAX_EVENTS,
+                         busy ? 0 : w->reads_sources ? pending_timeout() :
+                         100);
+
+        if (w->reads_sources)
+        {
+            flush_due();
+            busy = read_unpollable();
+        }
+
+        if (num < 0)
+            continue;
+
+        for (i = 0; i < num; i++)
+        {
+            conn = events[i].data.ptr;
+            if (conn->fd == -1)
+                continue;
+
+            switch (conn->type)
+            {
+            case CONN_CLIENT:
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    close_client(conn);
+                    break;
+                }
+                if (events[i].events & EPOLLOUT)
+                    write_client(conn);
+                if ((events[i].events & EPOLLIN) && conn->fd != -1)
+                    read_client(conn);
+                break;
+
+            /* check if there are any new connections pending */
+            case CONN_LISTEN:
+                accept_clients(conn);
+                break;
+
+            /* read data from gps */
+            case CONN_GPS:
+                read_gps(conn->src);
+                break;
+
+            /* sentences from the reader thread */
+            case CONN_WAKE:
+                if (read(conn->fd, &count, sizeof(count)) == -1 &&
+                    errno != EAGAIN)
+                    break;
+                take_handoff(w);
+                break;
+            }
+        }
+
+        free_closed(w, 0);
+    }
+}
+
+/* io_uring: a new connection from the multishot accept */
+static void uring_accepted(struct conn *listen_conn, int res, unsigned flags)
+{
+    struct worker  *w = listen_conn->w;
+    struct sockaddr_in cli_addr;
+    socklen_t       cli_len = sizeof(cli_addr);
+
+    if (res >= 0)
+    {
+        memset(&cli_addr, 0, sizeof(cli_addr));
+        getpeername(res, (struct sockaddr *)&cli_addr, &cli_len);
+        new_client(w, listen_conn->stream, res, &cli_addr);
+    }
+    else if (res == -EMFILE || res == -ENFILE)
+    {
+        /* out of descriptors: re-armed when a client goes away */
+        fprintf(stderr, "accept() error: %d: %s\n", -res, strerror(-res));
+        w->streams[listen_conn->stream].accept_paused = 1;
+        return;
+    }
+
+    if (!(flags & IORING_CQE_F_MORE))
+        uring_accept(w, listen_conn);
+}
+
+/* io_uring: data from a source, the reader or a client */
+static void uring_data(struct conn *conn, int res, unsigned flags)
+{
+    struct worker  *w = conn->w;
+    struct source  *src = conn->src;
+    uint8_t        *buf;
+    int             bid;
+
+    if (!(flags & IORING_CQE_F_MORE))
+        conn->inflight--;
+
+    if (flags & IORING_CQE_F_BUFFER)
+    {
+        bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (conn->type == CONN_GPS)
+        {
+            buf = w->uring_bufs + bid * URING_GPS_SIZE;
+            if (res == 1 && src->frm.len == 0 && buf[0] == 0x00)
+                res = 0;        /* EOF from some serial drivers */
+            else if (res > 0)
+                framer_push(&src->frm, buf, res);
+            uring_provide(w, BGID_GPS, bid);
+        }
+        else
+        {
+            if (res > 0 && conn->fd != -1)
+                client_input(conn, w->uring_net + bid * URING_NET_SIZE, res);
+            uring_provide(w, BGID_NET, bid);
+        }
+    }
+
+    if (conn->fd == -1)
+        return;
+
+    switch (conn->type)
+    {
+    case CONN_GPS:
+        if (res == 0)
+        {
+            flush_pending(src);
+            close_source(src);
+            return;
+        }
+        if (res > 0)
+            publish_sentences(src);
+        uring_read(conn);
+        break;
+
+    case CONN_WAKE:
+        take_handoff(w);
+        uring_read(conn);
+        break;
+
+    /* client commands are taken with the buffer */
+    default:
+        if (res == 0 || (res < 0 && res != -ENOBUFS && res != -EINTR))
+            close_client(conn);
+        else if (!(flags & IORING_CQE_F_MORE))
+            uring_read(conn);
+        break;
+    }
+}
+
+/* io_uring: a client write is done */
+static void uring_written(struct conn *conn, int res)
+{
+    conn->inflight--;
+    conn->writing = 0;
+
+    if (conn->fd == -1)
+        return;
+
+    if (res >= 0)
+        queue_consume(&conn->queue, res);
+    else if (res != -EAGAIN && res != -EINTR)
+    {
+        close_client(conn);
+        return;
+    }
+
+    uring_write(conn);
+}
+
+static void uring_loop(struct worker *w)
+{
+    struct io_uring_cqe *cqe;
+    struct conn    *conn;
+    uint64_t        data;
+    unsigned        flags;
+    int             res;
+
+    while (keep_running)
+    {
+        if (uring_submit(&w->ring,
+                         w->reads_sources ? pending_timeout() : 100) == -1)
+            break;
+
+        if (w->reads_sources)
+            flush_due();
+
+        while ((cqe = uring_peek(&w->ring)) != NULL)
+        {
+            data = cqe->user_data;
+            res = cqe->res;
+            flags = cqe->flags;
+            uring_seen(&w->ring);
+
+            conn = (struct conn *)(uintptr_t) (data & ~(uint64_t) 3);
+            switch (data & 3)
+            {
+            case OP_READ:
+                uring_data(conn, res, flags);
+                break;
+
+            case OP_WRITE:
+                uring_written(conn, res);
+                break;
+
+            case OP_ACCEPT:
+                uring_accepted(conn, res, flags);
+                break;
+            }
+        }
+
+        free_closed(w, 0);
+    }
+}
+
+/* io_uring: set up the ring, the buffers and the first requests */
+static int uring_start(struct worker *w)
+{
+    int             i, gps_bufs = w->reads_sources ?
+        URING_GPS_BUFS * num_sources : 0;
+
+    if (uring_init(&w->ring, URING_ENTRIES) == -1)
+        return -1;
+
+    w->uring_bufs = malloc(gps_bufs * URING_GPS_SIZE +
+                           URING_NET_BUFS * URING_NET_SIZE);
+    if (w->uring_bufs == NULL)
+    {
+        uring_exit(&w->ring);
+        return -1;
+    }
+    w->uring_net = w->uring_bufs + gps_bufs * URING_GPS_SIZE;
+
+    for (i = 0; i < gps_bufs; i++)
+        uring_provide(w, BGID_GPS, i);
+    for (i = 0; i < URING_NET_BUFS; i++)
+        uring_provide(w, BGID_NET, i);
+
+    for (i = 0; i < MAX_STREAMS; i++)
+        if (w->streams[i].listen_conn.fd != -1)
+            uring_accept(w, &w->streams[i].listen_conn);
+    for (i = 0; w->reads_sources && i < num_sources; i++)
+        uring_read(&sources[i].conn);
+    if (w->wake.fd != -1)
+        uring_read(&w->wake);
+
+    return 0;
+}
+
+/* Run the event loop of a worker until shutdown.
+ * Returns -1 if it could not be set up.
+ */
+static int run_worker(struct worker *w)
+{
+    struct stream  *st;
+    int             i;
+
+    if (w->cpu >= 0)
+        pin_thread(w->cpu);
+
+    if (use_uring)
+    {
+        w->uring = 1;
+        if (uring_start(w) == 0)
+        {
+            uring_loop(w);
+            return 0;
+        }
+        fprintf(stderr, "io_uring not available, using epoll\n");
+        w->uring = 0;
+    }
+
+    w->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (w->epoll_fd == -1)
+    {
+        fprintf(stderr, "epoll_create1() error: %d: %s\n", errno,
+                strerror(errno));
+        return -1;
+    }
+
+    for (i = 0; i < MAX_STREAMS; i++)
+    {
+        st = &w->streams[i];
+        if (st->listen_conn.fd == -1)
+            continue;
+
+        /* accept_clients() drains the backlog until EAGAIN */
+        fcntl(st->listen_conn.fd, F_SETFL,
+              fcntl(st->listen_conn.fd, F_GETFL) | O_NONBLOCK);
+
+        if (watch_fd(EPOLL_CTL_ADD, &st->listen_conn, EPOLLIN) == -1)
+            return -1;
+    }
+
+    for (i = 0; w->reads_sources && i < num_sources; i++)
+    {
+        /* plain files are read in every turn of the loop */
+        if (watch_fd(EPOLL_CTL_ADD, &sources[i].conn, EPOLLIN) == -1)
+        {
+            if (errno != EPERM)
+                return -1;
+            sources[i].pollable = 0;
+        }
+    }
+
+    if (w->wake.fd != -1 && watch_fd(EPOLL_CTL_ADD, &w->wake, EPOLLIN) == -1)
+        return -1;
+
+    epoll_loop(w);
+
+    return 0;
+}
+
+static void *worker_thread(void *arg)
+{
+    if (run_worker(arg) == -1)
+        keep_running = 0;
+
+    return NULL;
+}
+
+/* Set up a worker: its listening sockets and, for threads, the handoff */
+static int worker_init(struct worker *w, int idx)
+{
+    struct stream  *st;
+    int             i, stream_port;
+
+    memset(w, 0, sizeof(struct worker));
+    w->cpu = pin_cpus ? idx + 1 : -1;
+    w->epoll_fd = -1;
+    w->wake.type = CONN_WAKE;
+    w->wake.w = w;
+    w->wake.fd = -1;
+
+    for (i = 0; i < MAX_STREAMS; i++)
+    {
+        st = &w->streams[i];
+        st->listen_conn.type = CONN_LISTEN;
+        st->listen_conn.w = w;
+        st->listen_conn.stream = i;
+        st->listen_conn.fd = -1;
+    }
+
+    for (i = 0; i < MAX_STREAMS; i++)
+    {
+        if (i == shared_stream)
+            stream_port = shared_port;
+        else if (i < num_sources && port > 0)
+            stream_port = port + i;
+        else
+            continue;
+
+        if (stream_port <= 0)
+            continue;
+
+        st = &w->streams[i];
+        st->listen_conn.fd = tcp_listen(stream_port, backlog, num_workers > 0);
+        if (st->listen_conn.fd == -1)
+            return -1;
+
+        st->holds = calloc(i == shared_stream ? num_sources : 1,
+                           sizeof(struct hold));
+        if (st->holds == NULL)
+            return -1;
+    }
+
+    if (num_workers == 0)
+        return 0;
+
+    w->wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (w->wake.fd == -1)
+    {
+        fprintf(stderr, "eventfd() error: %d: %s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    if (spsc_init(&w->handoff, HANDOFF_SIZE) == -1)
+    {
+        fprintf(stderr, "Error allocating handoff ring\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Close the clients of a stopped worker and free it */
+static void worker_free(struct worker *w)
+{
+    struct stream  *st;
+    struct chunk   *c;
+    int             i, j;
+
+    for (i = 0; i < MAX_STREAMS; i++)
+    {
+        st = &w->streams[i];
+        while (st->num_clients > 0)
+            close_client(st->clients[st->num_clients - 1]);
+    }
+    if (w->uring)
+    {
+        /* no more completions after this, requests in flight or not */
+        uring_exit(&w->ring);
+        free(w->uring_bufs);
+    }
+    free_closed(w, 1);
+
+    for (i = 0; i < MAX_STREAMS; i++)
+    {
+        st = &w->streams[i];
+        free(st->clients);
+        if (st->holds != NULL)
+        {
+            for (j = 0; j < (i == shared_stream ? num_sources : 1); j++)
+                hold_clear(&st->holds[j]);
+            free(st->holds);
+        }
+        if (st->listen_conn.fd != -1)
+            close(st->listen_conn.fd);
+    }
+
+    if (w->handoff.items != NULL)
+    {
+        while ((c = spsc_pop(&w->handoff)) != NULL)
+            chunk_put(c);
+        spsc_free(&w->handoff);
+    }
+
+    if (w->epoll_fd != -1)
+        close(w->epoll_fd);
+    if (w->wake.fd != -1)
+        close(w->wake.fd);
+}
+
+/* Read the sources and hand the sentences to the worker threads */
+static void reader_loop(void)
+{
+    struct pollfd   pfd[MAX_SOURCES];
+    int             i, num;
+
+    if (pin_cpus)
+        pin_thread(0);
+
+    while (keep_running)
+    {
+        /* closed sources have fd -1 and are skipped by poll() */
+        for (i = 0; i < num_sources; i++)
+        {
+            pfd[i].fd = sources[i].conn.fd;
+            pfd[i].events = POLLIN;
+            pfd[i].revents = 0;
+        }
+
+        num = poll(pfd, num_sources, pending_timeout());
+
+        flush_due();
+
+        for (i = 0; num > 0 && i < num_sources; i++)
+            if (pfd[i].revents)
+                read_gps(&sources[i]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int             exit_code = EXIT_FAILURE;
+    int             i, num_loops = 0, started = 0;
+    uint64_t        msgs_dropped = 0, slow_clients = 0, handoff_dropped = 0;
+    sigset_t        block, old;
+    struct source  *src;
+
+    parse_options(argc, argv);
+
+    /* setup signal handler */
+    if (signal(SIGINT, signal_handler) == SIG_ERR)
+        printf("Warning: Can't catch SIGINT\n");
+    if (signal(SIGTERM, signal_handler) == SIG_ERR)
+        printf("Warning: Can't catch SIGTERM\n");
+
+    /* a client going away must not kill the server */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* open the sources */
+    if (num_sources == 0)
+        add_source("/dev/ttyO1");
+    shared_stream = num_sources;
+    for (i = 0; i < num_sources; i++)
+    {
+        source_names[i] = sources[i].name;
+        if (open_source(&sources[i], i) == -1)
+            goto cleanup;
+    }
+
+    filter_all(&default_filter);
+    if (filter_text != NULL &&
+        filter_parse(&default_filter, filter_text, source_names,
+                     num_sources) == -1)
+    {
+        fprintf(stderr, "Bad filter: %s\n", filter_text);
+        goto cleanup;
+    }
+
+    for (i = 0; i < num_rates; i++)
+        if (parse_rate(rate_text[i]) == -1)
+            goto cleanup;
+
+    if (bcast_init(&bcast, BCAST_SLOTS, MAX_TAG + RDBUF_SIZE) == -1)
+    {
+        fprintf(stderr, "Error allocating broadcast ring\n");
+        goto cleanup;
+    }
+
+    /* open and configure network interfaces, one set per worker */
+    workers = calloc(num_workers > 0 ? num_workers : 1,
+                     sizeof(struct worker));
+    if (workers == NULL)
+        goto cleanup;
+
+    do
+    {
+        i = num_loops++;
+        /* a worker half set up is freed with the others */
+        if (worker_init(&workers[i], i) == -1)
+            goto cleanup;
+    }
+    while (num_loops < num_workers);
+
+    if (num_workers == 0)
+    {
+        workers[0].reads_sources = 1;
+        workers[0].cpu = pin_cpus ? 0 : -1;
+        for (i = 0; i < num_sources; i++)
+            sources[i].conn.w = &workers[0];
+
+        if (run_worker(&workers[0]) == -1)
+            goto cleanup;
+    }
+    else
+    {
+        /* signals go to the reader, workers only see keep_running */
+        sigemptyset(&block);
+        sigaddset(&block, SIGINT);
+        sigaddset(&block, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &block, &old);
+
+        for (started = 0; started < num_workers; started++)
+        {
+            if (pthread_create(&workers[started].thread, NULL,
+                               worker_thread, &workers[started]) != 0)
+            {
+                fprintf(stderr, "Error starting worker thread\n");
+                keep_running = 0;
+                break;
+            }
+        }
+
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+        fprintf(stderr, "Serving clients from %d threads\n", started);
+        reader_loop();
+    }
+
+    fprintf(stderr, "Shutting down...\n");
+    exit_code = EXIT_SUCCESS;
+
+  cleanup:
+    keep_running = 0;
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    for (i = 0; workers != NULL && i < num_sources; i++)
+        flush_pending(&sources[i]);
+    for (i = 0; i < num_loops; i++)
+    {
+        worker_free(&workers[i]);
+        msgs_dropped += workers[i].msgs_dropped;
+        slow_clients += workers[i].slow_clients;
+        handoff_dropped += workers[i].handoff_dropped;
+    }
+    free(workers);
+
+    for (i = 0; i < num_sources; i++)
+    {
+        src = &sources[i];
+        if (src->conn.fd != -1)
+            close(src->conn.fd);
+
+        fprintf(stderr, "  Source %s (%s)\n", src->name, src->dev);
+        fprintf(stderr, "    Valid messages: %" PRIu64 "\n",
+                src->frm.valid_pkts);
+        fprintf(stderr, "  Invalid messages: %" PRIu64 "\n",
+                src->frm.invalid_pkts);
+        fprintf(stderr, "   Checksum errors: %" PRIu64 "\n",
+                src->frm.crc_errors);
+        fprintf(stderr, "     Skipped bytes: %" PRIu64 "\n", src->frm.skipped);
+        free(src->name);
+        free(src->dev);
+    }
+    free(filter_text);
+    for (i = 0; i < num_rates; i++)
+        free(rate_text[i]);
 
-    fprintf(stderr, "    Valid messages: %" PRIu64 "\n", gps_buf.valid_pkts);
-    fprintf(stderr, "  Invalid messages: %" PRIu64 "\n", gps_buf.invalid_pkts);
+    fprintf(stderr, "  Dropped messages: %" PRIu64 "\n", msgs_dropped);
+    fprintf(stderr, "      Slow clients: %" PRIu64 "\n", slow_clients);
+    fprintf(stderr, "  Dropped handoffs: %" PRIu64 "\n", handoff_dropped);
+    fprintf(stderr, "   Chunks off ring: %" PRIu64 "\n", bcast.spares);
+    bcast_free(&bcast);
 
     exit(exit_code);
 }
@@ -0,0 +1,640 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+
+/*
+ * gpsreplay - play back a recorded NMEA log with its original timing.
+ *
+ * The log is split into epochs at every change of the UTC time found in
+ * GGA, RMC, GLL and ZDA sentences (any talker). Lines without a time stay
+ * with the epoch they were recorded in. Each epoch is written in one go
+ * at its original offset from the start, divided by the speed factor.
+ * Epochs are only ever written whole: at speed 0 the replay goes at the
+ * pace of the slowest reader, otherwise a reader still busy with the
+ * last epoch skips the new one.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>           // PRId64 and PRIu64
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+
+
+#define OUT_STDOUT      0
+#define OUT_PTY         1
+#define OUT_FIFO        2
+#define OUT_TCP         3
+
+#define MAX_CLIENTS     16
+
+/* Time of day jumping back by more than this means a new day */
+#define DAY_WRAP        43200.0
+
+/* An output and the part of an epoch it has not taken yet. The rest of
+   an epoch is always written before the next one, so that a slow reader
+   never gets half a sentence. */
+struct output {
+    int             fd;
+    const char     *tail;       /* points into the log */
+    size_t          tail_len;
+};
+
+struct epoch {
+    size_t          off;        /* offset of first byte in the log */
+    size_t          len;        /* number of bytes */
+    double          t;          /* UTC in seconds since start of first day */
+};
+
+static char    *log_file = NULL;
+static int      out_mode = OUT_STDOUT;
+static char    *fifo_path = NULL;
+static int      port = 45001;   /* TCP port */
+static double   speed = 1.0;    /* 0 means as fast as possible */
+static int      loop = 0;
+static char    *seek = NULL;    /* hh:mm:ss or +seconds */
+static int      keep_running = 1;
+
+static struct output out = { -1, NULL, 0 };
+static int      listen_fd = -1;
+static struct output clients[MAX_CLIENTS];
+
+static uint64_t epochs_sent = 0;
+static uint64_t bytes_sent = 0;
+static uint64_t dropped = 0;
+static uint64_t late_max = 0;
+
+
+void signal_handler(int signo)
+{
+    if (signo == SIGINT)
+        fprintf(stderr, "\nCaught SIGINT\n");
+    else if (signo == SIGTERM)
+        fprintf(stderr, "\nCaught SIGTERM\n");
+    else
+        fprintf(stderr, "\nCaught signal: %d\n", signo);
+
+    keep_running = 0;
+}
+
+static void help(void)
+{
+    static const char help_string[] =
+        "\n Usage: gpsreplay [options] logfile\n"
+        "\n Possible options are:\n"
+        "\n"
+        "  -o out    Output: stdout, pty, fifo or tcp (default is stdout).\n"
+        "  -f path   Path of the fifo (default is /tmp/gpsreplay).\n"
+        "  -p port   TCP port (default is 45001).\n"
+        "  -x factor Speed factor, 0 for as fast as possible (default is 1).\n"
+        "  -l        Loop forever.\n"
+        "  -S time   Start at UTC hh:mm:ss[.ss] or at +seconds into the log.\n"
+        "  -h        This help message.\n\n";
+
+    fprintf(stderr, "%s", help_string);
+}
+
+/* Parse command line options */
+static void parse_options(int argc, char **argv)
+{
+    int             option;
+
+    if (argc > 1)
+    {
+        while ((option = getopt(argc, argv, "o:f:p:x:lS:h")) != -1)
+        {
+            switch (option)
+            {
+            case 'o':
+                if (strcmp(optarg, "pty") == 0)
+                    out_mode = OUT_PTY;
+                else if (strcmp(optarg, "fifo") == 0)
+                    out_mode = OUT_FIFO;
+                else if (strcmp(optarg, "tcp") == 0)
+                    out_mode = OUT_TCP;
+                else
+                    out_mode = OUT_STDOUT;
+                break;
+
+            case 'f':
+                fifo_path = strdup(optarg);
+                break;
+
+            case 'p':
+                port = atoi(optarg);
+                break;
+
+            case 'x':
+                speed = atof(optarg);
+                break;
+
+            case 'l':
+                loop = 1;
+                break;
+
+            case 'S':
+                seek = strdup(optarg);
+                break;
+
+            case 'h':
+                help();
+                exit(EXIT_SUCCESS);
+
+            default:
+                help();
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    if (optind < argc)
+        log_file = strdup(argv[optind]);
+
+    if (log_file == NULL)
+    {
+        help();
+        exit(EXIT_FAILURE);
+    }
+
+    if (speed < 0)
+        speed = 0;
+    if (fifo_path == NULL)
+        fifo_path = strdup("/tmp/gpsreplay");
+}
+
+/* Read the whole log into memory */
+static char    *load_file(const char *name, size_t *size)
+{
+    FILE           *file;
+    char           *data;
+    long            len;
+
+    file = fopen(name, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error opening %s: %d (%s)\n", name, errno,
+                strerror(errno));
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = malloc(len > 0 ? len : 1);
+    if (data == NULL || fread(data, 1, len, file) != (size_t) len)
+    {
+        fprintf(stderr, "Error reading %s\n", name);
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    *size = len;
+
+    return data;
+}
+
+/* Split the log into epochs, returns the number of epochs */
+static size_t index_log(const char *data, size_t size, struct epoch **epochs)
+{
+    struct epoch   *ep = NULL;
+    size_t          num = 0;
+    size_t          cap = 0;
+    size_t          off;
+    size_t          len;
+    double          tod = 0.0;
+    double          prev_tod = 0.0;
+    double          days = 0.0;
+    int             has_time;
+    int             have_time = 0;
+
+    for (off = 0; off < size; off += len)
+    {
+        for (len = 0; off + len < size && data[off + len] != '\n'; len++) ;
+        if (off + len < size)
+            len++;              /* include line feed */
+
+        has_time = sentence_time(data + off, len, &tod);
+
+        /* new epoch when the time changes */
+        if (num == 0 || (has_time && have_time && tod != prev_tod))
+        {
+            if (num == cap)
+            {
+                cap = cap ? 2 * cap : 1024;
+                ep = realloc(ep, cap * sizeof(struct epoch));
+                if (ep == NULL)
+                {
+                    fprintf(stderr, "Out of memory\n");
+                    return 0;
+                }
+            }
+
+            if (has_time && have_time && tod < prev_tod - DAY_WRAP)
+                days += 86400.0;
+
+            ep[num].off = off;
+            ep[num].len = 0;
+            ep[num].t = days + tod;
+            num++;
+        }
+
+        /* lines before the first time belong to the first epoch */
+        if (has_time)
+        {
+            if (!have_time)
+                ep[num - 1].t = tod;
+            prev_tod = tod;
+            have_time = 1;
+        }
+
+        ep[num - 1].len += len;
+    }
+
+    *epochs = ep;
+
+    return num;
+}
+
+/* Index of first epoch at or after the requested seek time */
+static size_t find_start(const struct epoch *ep, size_t num)
+{
+    double          t;
+    int             h = 0, m = 0;
+    double          s = 0.0;
+    size_t          lo = 0, hi = num;
+    size_t          mid;
+
+    if (seek == NULL || num == 0)
+        return 0;
+
+    if (seek[0] == '+')
+    {
+        t = ep[0].t + atof(seek + 1);
+    }
+    else
+    {
+        sscanf(seek, "%d:%d:%lf", &h, &m, &s);
+        t = h * 3600.0 + m * 60.0 + s;
+        /* same time of day on a later day of the log */
+        while (t < ep[0].t - DAY_WRAP)
+            t += 86400.0;
+    }
+
+    /* times are not guaranteed to be monotonic but close enough */
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (ep[mid].t < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo < num ? lo : num - 1;
+}
+
+static int open_output(void)
+{
+    char            name[64];
+    int             i;
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+        clients[i].fd = -1;
+
+    switch (out_mode)
+    {
+    case OUT_PTY:
+        out.fd = pty_open(name, sizeof(name));
+        if (out.fd != -1)
+            fprintf(stderr, "Replaying to %s\n", name);
+        return out.fd;
+
+    case OUT_FIFO:
+        if (mkfifo(fifo_path, 0666) == -1 && errno != EEXIST)
+        {
+            fprintf(stderr, "mkfifo(%s) error: %d: %s\n", fifo_path, errno,
+                    strerror(errno));
+            return -1;
+        }
+        out.fd = open(fifo_path, O_RDWR | O_NONBLOCK);
+        fprintf(stderr, "Replaying to %s\n", fifo_path);
+        return out.fd;
+
+    case OUT_TCP:
+        listen_fd = tcp_listen(port, MAX_CLIENTS, 0);
+        if (listen_fd != -1)
+            fprintf(stderr, "Replaying to TCP port %d\n", port);
+        return listen_fd;
+
+    default:
+        out.fd = STDOUT_FILENO;
+        return out.fd;
+    }
+}
+
+static void accept_client(void)
+{
+    int             new;
+    int             i;
+
+    new = accept(listen_fd, NULL, NULL);
+    if (new == -1)
+        return;
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd == -1)
+        {
+            fcntl(new, F_SETFL, O_NONBLOCK);
+            clients[i].fd = new;
+            clients[i].tail_len = 0;
+            fprintf(stderr, "Connection accepted (FD=%d)\n", new);
+            return;
+        }
+    }
+
+    fprintf(stderr, "Connection refused (FD=%d)\n", new);
+    close(new);
+}
+
+/* Write as much of the rest of an epoch as the output takes.
+ * Returns 0 when all is written, 1 if some is left and -1 on error.
+ */
+static int flush_output(struct output *o, int is_client)
+{
+    ssize_t         written;
+
+    while (o->tail_len > 0)
+    {
+        written = write(o->fd, o->tail, o->tail_len);
+        if (written > 0)
+        {
+            o->tail += written;
+            o->tail_len -= written;
+            bytes_sent += written;
+            continue;
+        }
+
+        if (written == -1 && (errno == EAGAIN || errno == EINTR))
+            return 1;
+
+        if (is_client)
+        {
+            fprintf(stderr, "Connection closed (FD=%d)\n", o->fd);
+            close(o->fd);
+            o->fd = -1;
+        }
+        else
+        {
+            fprintf(stderr, "Error writing output: %d: %s\n", errno,
+                    strerror(errno));
+            keep_running = 0;
+        }
+        o->tail_len = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Start writing an epoch, unless the output is still busy with the one
+   before; then the new one is dropped whole */
+static void send_output(struct output *o, const char *data, size_t len,
+                        int is_client)
+{
+    if (o->tail_len > 0 && flush_output(o, is_client) != 0)
+    {
+        dropped++;
+        return;
+    }
+
+    o->tail = data;
+    o->tail_len = len;
+    flush_output(o, is_client);
+}
+
+/* Returns 1 if an output has part of an epoch left */
+static int outputs_pending(void)
+{
+    int             i;
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+        if (clients[i].fd != -1 && clients[i].tail_len > 0)
+            return 1;
+
+    return out.fd != -1 && out.tail_len > 0;
+}
+
+/* Wait up to timeout_ms for new TCP clients and for outputs to take the
+   rest of their epoch */
+static void poll_outputs(int timeout_ms)
+{
+    struct pollfd   pfd[MAX_CLIENTS + 2];
+    struct output  *o[MAX_CLIENTS + 2];
+    int             i, num = 0;
+
+    if (listen_fd != -1)
+    {
+        pfd[num].fd = listen_fd;
+        pfd[num].events = POLLIN;
+        o[num++] = NULL;
+    }
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd != -1 && clients[i].tail_len > 0)
+        {
+            pfd[num].fd = clients[i].fd;
+            pfd[num].events = POLLOUT;
+            o[num++] = &clients[i];
+        }
+    }
+
+    if (out.fd != -1 && out.tail_len > 0)
+    {
+        pfd[num].fd = out.fd;
+        pfd[num].events = POLLOUT;
+        o[num++] = &out;
+    }
+
+    if (poll(pfd, num, timeout_ms) <= 0)
+        return;
+
+    for (i = 0; i < num; i++)
+    {
+        if (pfd[i].revents == 0)
+            continue;
+        if (o[i] == NULL)
+            accept_client();
+        else
+            flush_output(o[i], o[i] != &out);
+    }
+}
+
+/* Sleep until the given time, accepting TCP clients and writing the rest
+   of the last epoch meanwhile */
+static void wait_until(uint64_t due)
+{
+    uint64_t        now;
+    int64_t         wait_ms;
+
+    while (keep_running && (now = time_us()) < due)
+    {
+        wait_ms = (due - now + 999) / 1000;
+        if (wait_ms > 100)
+            wait_ms = 100;
+
+        poll_outputs(wait_ms);
+    }
+}
+
+/* As fast as possible, but at the pace of the slowest reader */
+static void wait_outputs(void)
+{
+    do
+        poll_outputs(outputs_pending() ? 100 : 0);
+    while (keep_running && outputs_pending());
+}
+
+static void send_epoch(const char *data, const struct epoch *ep)
+{
+    int             i;
+
+    if (out_mode == OUT_TCP)
+    {
+        for (i = 0; i < MAX_CLIENTS; i++)
+            if (clients[i].fd != -1)
+                send_output(&clients[i], data + ep->off, ep->len, 1);
+    }
+    else
+    {
+        send_output(&out, data + ep->off, ep->len, 0);
+    }
+
+    epochs_sent++;
+}
+
+int main(int argc, char **argv)
+{
+    int             exit_code = EXIT_FAILURE;
+    char           *data;
+    size_t          size;
+    struct epoch   *ep = NULL;
+    size_t          num;
+    size_t          first;
+    size_t          i;
+    uint64_t        wall0;      /* wall clock of epoch at t0 */
+    uint64_t        due;
+    uint64_t        now;
+    double          t0;
+    double          gap;
+
+    parse_options(argc, argv);
+
+    /* setup signal handler */
+    if (signal(SIGINT, signal_handler) == SIG_ERR)
+        printf("Warning: Can't catch SIGINT\n");
+    if (signal(SIGTERM, signal_handler) == SIG_ERR)
+        printf("Warning: Can't catch SIGTERM\n");
+    signal(SIGPIPE, SIG_IGN);
+
+    data = load_file(log_file, &size);
+    if (data == NULL)
+        exit(EXIT_FAILURE);
+
+    num = index_log(data, size, &ep);
+    if (num == 0)
+    {
+        fprintf(stderr, "No data in %s\n", log_file);
+        goto cleanup;
+    }
+
+    first = find_start(ep, num);
+    fprintf(stderr, "%zu epochs, %.1f s, starting at epoch %zu\n", num,
+            ep[num - 1].t - ep[0].t, first);
+
+    /* pause between loops: typical epoch interval */
+    gap = num > 1 ? (ep[num - 1].t - ep[0].t) / (num - 1) : 1.0;
+
+    if (open_output() == -1)
+        goto cleanup;
+
+    i = first;
+    t0 = ep[i].t;
+    wall0 = time_us();
+
+    while (keep_running)
+    {
+        if (speed > 0)
+        {
+            /* restart the clock if the log jumps back in time */
+            if (ep[i].t < t0)
+            {
+                t0 = ep[i].t;
+                wall0 = time_us();
+            }
+
+            due = wall0 + (uint64_t) ((ep[i].t - t0) / speed * 1e6);
+            wait_until(due);
+
+            now = time_us();
+            if (now > due && now - due > late_max)
+                late_max = now - due;
+        }
+        else
+        {
+            wait_outputs();
+        }
+
+        if (!keep_running)
+            break;
+
+        send_epoch(data, &ep[i]);
+
+        if (++i == num)
+        {
+            if (!loop)
+                break;
+
+            i = first;
+            t0 = ep[i].t;
+            wall0 = time_us() + (speed > 0 ? (uint64_t) (gap / speed * 1e6) : 0);
+        }
+    }
+
+    fprintf(stderr, "Shutting down...\n");
+    exit_code = EXIT_SUCCESS;
+
+  cleanup:
+    for (i = 0; i < MAX_CLIENTS; i++)
+        if (clients[i].fd > 0)
+            close(clients[i].fd);
+    if (listen_fd != -1)
+        close(listen_fd);
+    if (out.fd > STDOUT_FILENO)
+        close(out.fd);
+
+    fprintf(stderr, "      Epochs sent: %" PRIu64 "\n", epochs_sent);
+    fprintf(stderr, "       Bytes sent: %" PRIu64 "\n", bytes_sent);
+    fprintf(stderr, "   Dropped epochs: %" PRIu64 "\n", dropped);
+    fprintf(stderr, "   Max delay (us): %" PRIu64 "\n", late_max);
+
+    free(ep);
+    free(data);
+
+    exit(exit_code);
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "queue.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Max messages per writev() */
+#define FLUSH_IOV       (IOV_MAX < 64 ? IOV_MAX : 64)
+
+void queue_init(struct msg_queue *q, size_t limit)
+{
+    memset(q, 0, sizeof(struct msg_queue));
+    q->limit = limit;
+}
+
+void queue_free(struct msg_queue *q)
+{
+    while (q->count > 0)
+    {
+        chunk_put(q->msgs[q->head]);
+        q->head = (q->head + 1) & (q->size - 1);
+        q->count--;
+    }
+
+    free(q->msgs);
+    q->msgs = NULL;
+    q->size = 0;
+    q->bytes = 0;
+    q->sent = 0;
+}
+
+int queue_push(struct msg_queue *q, struct chunk *m, int sent)
+{
+    struct chunk  **msgs;
+    int             size, i;
+
+    if (q->bytes + m->len - sent > q->limit)
+        return -1;
+
+    if (q->count == q->size)
+    {
+        size = q->size ? 2 * q->size : 16;
+        msgs = malloc(size * sizeof(struct chunk *));
+        if (msgs == NULL)
+            return -1;
+
+        /* unroll the ring at the start of the new one */
+        for (i = 0; i < q->count; i++)
+            msgs[i] = q->msgs[(q->head + i) & (q->size - 1)];
+
+        free(q->msgs);
+        q->msgs = msgs;
+        q->size = size;
+        q->head = 0;
+    }
+
+    if (q->count == 0)
+        q->sent = sent;
+
+    chunk_get(m);
+    q->msgs[(q->head + q->count) & (q->size - 1)] = m;
+    q->count++;
+    q->bytes += m->len - sent;
+
+    return 0;
+}
+
+/* Remove message i (0 is the first one) */
+static void queue_remove(struct msg_queue *q, int i)
+{
+    int             mask = q->size - 1;
+    int             j;
+    struct chunk   *m = q->msgs[(q->head + i) & mask];
+
+    q->bytes -= m->len - (i == 0 ? q->sent : 0);
+    if (i == 0)
+        q->sent = 0;
+    chunk_put(m);
+
+    /* close the gap by moving the earlier messages up */
+    for (j = i; j > 0; j--)
+        q->msgs[(q->head + j) & mask] = q->msgs[(q->head + j - 1) & mask];
+
+    q->head = (q->head + 1) & mask;
+    q->count--;
+}
+
+/* Number of messages at the front that must not be dropped */
+static int queue_kept(const struct msg_queue *q)
+{
+    /* the first message is kept if it is partly written */
+    if (q->locked > 0)
+        return q->locked;
+    return (q->sent > 0);
+}
+
+int queue_drop_oldest(struct msg_queue *q, size_t len)
+{
+    int             first = queue_kept(q);
+
+    while (q->bytes + len > q->limit && q->count > first)
+    {
+        queue_remove(q, first);
+        q->dropped++;
+    }
+
+    return (q->bytes + len > q->limit) ? -1 : 0;
+}
+
+void queue_drop_epochs(struct msg_queue *q, int source, uint64_t epoch)
+{
+    int             mask = q->size - 1;
+    int             first = queue_kept(q);
+    int             i, num = first;
+    struct chunk   *m;
+
+    /* keep the order of the others, closing the gaps towards the tail */
+    for (i = first; i < q->count; i++)
+    {
+        m = q->msgs[(q->head + i) & mask];
+        if (m->source == source && m->epoch < epoch)
+        {
+            /* not partly written, or it would be kept */
+            q->bytes -= m->len;
+            chunk_put(m);
+            q->dropped++;
+            continue;
+        }
+        q->msgs[(q->head + num++) & mask] = m;
+    }
+
+    q->count = num;
+}
+
+int queue_iov(struct msg_queue *q, struct iovec *iov, int max)
+{
+    struct chunk   *m;
+    int             num, i;
+
+    num = q->count < max ? q->count : max;
+    for (i = 0; i < num; i++)
+    {
+        m = q->msgs[(q->head + i) & (q->size - 1)];
+        iov[i].iov_base = m->data + (i == 0 ? q->sent : 0);
+        iov[i].iov_len = m->len - (i == 0 ? q->sent : 0);
+    }
+
+    return num;
+}
+
+void queue_consume(struct msg_queue *q, size_t len)
+{
+    struct chunk   *m;
+
+    q->bytes -= len;
+    q->locked = 0;
+
+    /* release the messages written in full */
+    while (len > 0)
+    {
+        m = q->msgs[q->head];
+        if (len < (size_t) (m->len - q->sent))
+        {
+            q->sent += len;
+            break;
+        }
+
+        len -= m->len - q->sent;
+        q->sent = 0;
+        chunk_put(m);
+        q->head = (q->head + 1) & (q->size - 1);
+        q->count--;
+    }
+}
+
+int queue_flush(struct msg_queue *q, int fd)
+{
+    struct iovec    iov[FLUSH_IOV];
+    ssize_t         written, want;
+    int             num, i;
+
+    while (q->count > 0)
+    {
+        num = queue_iov(q, iov, FLUSH_IOV);
+        for (want = 0, i = 0; i < num; i++)
+            want += iov[i].iov_len;
+
+        written = writev(fd, iov, num);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : -1;
+        }
+
+        queue_consume(q, written);
+
+        /* socket full */
+        if (written < want)
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#ifndef __QUEUE_H__
+#define __QUEUE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "bcast.h"
+
+/* Bounded output queue of a client.
+ *
+ * The queue holds references to broadcast chunks in a ring and writes
+ * them with writev(), so queued data is never copied per client. The
+ * first chunk may be partly written; it is never dropped, so that a
+ * client never sees half a sentence.
+ */
+struct msg_queue {
+    struct chunk  **msgs;       /* ring of chunks */
+    int             size;       /* ring slots, power of two */
+    int             head;       /* slot of first message */
+    int             count;      /* number of messages */
+    size_t          bytes;      /* bytes queued, not counting sent */
+    size_t          limit;      /* max bytes queued */
+    int             sent;       /* bytes of first message already written */
+    int             locked;     /* messages at the front being written */
+    uint64_t        dropped;    /* messages dropped */
+};
+
+void            queue_init(struct msg_queue *q, size_t limit);
+void            queue_free(struct msg_queue *q);
+
+/** Append a chunk, taking a reference to it.
+ *  @param  sent  Bytes of the message already written to the client.
+ *  @returns 0 on success, -1 if the limit or memory would be exceeded.
+ */
+int             queue_push(struct msg_queue *q, struct chunk *c, int sent);
+
+/** Drop messages from the front until len more bytes fit.
+ *  @returns 0 if they fit now, -1 if not.
+ */
+int             queue_drop_oldest(struct msg_queue *q, size_t len);
+
+/** Drop all whole messages of a source older than epoch.
+ *  @param  source  Messages of other sources are kept, their epochs are
+ *                  numbered along but they are not older.
+ */
+void            queue_drop_epochs(struct msg_queue *q, int source,
+                                  uint64_t epoch);
+
+/** Describe the front of the queue for writev() or an async write.
+ *  @returns Number of iovecs filled, at most max.
+ *
+ * For an async write set q->locked to the returned number until
+ * queue_consume(), so that the messages are not dropped meanwhile.
+ */
+int             queue_iov(struct msg_queue *q, struct iovec *iov, int max);
+
+/** Release len bytes written from the front of the queue. */
+void            queue_consume(struct msg_queue *q, size_t len);
+
+/** Write as much of the queue as the socket takes.
+ *  @returns 0 when the queue is empty, 1 if data is left and -1 on
+ *           error other than EAGAIN.
+ */
+int             queue_flush(struct msg_queue *q, int fd);
+
+#endif
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc.h"
+
+int spsc_init(struct spsc *r, unsigned size)
+{
+    unsigned        num = 1;
+
+    memset(r, 0, sizeof(struct spsc));
+
+    while (num < size)
+        num *= 2;
+
+    r->items = malloc(num * sizeof(void *));
+    if (r->items == NULL)
+        return -1;
+
+    r->mask = num - 1;
+
+    return 0;
+}
+
+void spsc_free(struct spsc *r)
+{
+    free(r->items);
+    r->items = NULL;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#ifndef __SPSC_H__
+#define __SPSC_H__
+
+#define SPSC_CACHE_LINE 64
+
+/* Lock free ring of pointers between one producer and one consumer thread.
+ *
+ * Head and tail are only ever written by one side each and sit on their
+ * own cache lines; each side keeps a copy of the other's index and only
+ * reads the shared one when the copy says the ring is full or empty.
+ */
+struct spsc {
+    void          **items;
+    unsigned        mask;       /* size - 1, size is a power of two */
+
+    /* consumer */
+    unsigned        head __attribute__ ((aligned(SPSC_CACHE_LINE)));
+    unsigned        tail_cache;
+
+    /* producer */
+    unsigned        tail __attribute__ ((aligned(SPSC_CACHE_LINE)));
+    unsigned        head_cache;
+};
+
+/** Allocate a ring for at least size items.
+ *  @returns 0 on success, -1 if out of memory.
+ */
+int             spsc_init(struct spsc *r, unsigned size);
+void            spsc_free(struct spsc *r);
+
+/** Append an item, producer side.
+ *  @returns 0 on success, -1 if the ring is full.
+ */
+static inline int spsc_push(struct spsc *r, void *item)
+{
+    unsigned        tail = r->tail;
+
+    if (tail - r->head_cache > r->mask)
+    {
+        r->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (tail - r->head_cache > r->mask)
+            return -1;
+    }
+
+    r->items[tail & r->mask] = item;
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/** Take the oldest item, consumer side.
+ *  @returns The item or NULL if the ring is empty.
+ */
+static inline void *spsc_pop(struct spsc *r)
+{
+    unsigned        head = r->head;
+    void           *item;
+
+    if (head == r->tail_cache)
+    {
+        r->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (head == r->tail_cache)
+            return NULL;
+    }
+
+    item = r->items[head & r->mask];
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+    return item;
+}
+
+#endif
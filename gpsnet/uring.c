@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+static int uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags, void *arg, size_t argsz)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   arg, argsz);
+}
+
+/* Multishot receive came with Linux 6.0, as did zero copy send; the
+   latter can be probed for */
+static int uring_probe(int fd)
+{
+    struct io_uring_probe *probe;
+    size_t          len;
+    int             ok = 0;
+
+    len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    probe = calloc(1, len);
+    if (probe == NULL)
+        return 0;
+
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256)
+        == 0 && probe->last_op >= IORING_OP_SEND_ZC)
+        ok = probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED;
+
+    free(probe);
+
+    return ok;
+}
+
+int uring_init(struct uring *r, unsigned entries)
+{
+    struct io_uring_params p;
+    size_t          sq_len, cq_len;
+    unsigned       *array;
+    unsigned        i;
+    uint8_t        *rings;
+
+    memset(r, 0, sizeof(struct uring));
+    memset(&p, 0, sizeof(p));
+
+    r->fd = uring_setup(entries, &p);
+    if (r->fd == -1)
+    {
+        fprintf(stderr, "io_uring_setup() error: %d: %s\n", errno,
+                strerror(errno));
+        return -1;
+    }
+
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(p.features & IORING_FEAT_EXT_ARG) || !uring_probe(r->fd))
+    {
+        fprintf(stderr, "io_uring is too old\n");
+        close(r->fd);
+        return -1;
+    }
+
+    sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->rings_len = sq_len > cq_len ? sq_len : cq_len;
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    r->rings = mmap(NULL, r->rings_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->rings == MAP_FAILED || r->sqes == MAP_FAILED)
+    {
+        fprintf(stderr, "io_uring mmap() error: %d: %s\n", errno,
+                strerror(errno));
+        if (r->rings == MAP_FAILED)
+            r->rings = NULL;
+        if (r->sqes == MAP_FAILED)
+            r->sqes = NULL;
+        uring_exit(r);
+        return -1;
+    }
+
+    rings = r->rings;
+    r->sq_head = (unsigned *)(rings + p.sq_off.head);
+    r->sq_tail = (unsigned *)(rings + p.sq_off.tail);
+    r->sq_mask = *(unsigned *)(rings + p.sq_off.ring_mask);
+    r->sq_local = *r->sq_tail;
+    r->cq_head = (unsigned *)(rings + p.cq_off.head);
+    r->cq_tail = (unsigned *)(rings + p.cq_off.tail);
+    r->cq_mask = *(unsigned *)(rings + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(rings + p.cq_off.cqes);
+
+    /* SQ slot i always holds SQE i */
+    array = (unsigned *)(rings + p.sq_off.array);
+    for (i = 0; i <= r->sq_mask; i++)
+        array[i] = i;
+
+    return 0;
+}
+
+void uring_exit(struct uring *r)
+{
+    if (r->sqes != NULL)
+        munmap(r->sqes, r->sqes_len);
+    if (r->rings != NULL)
+        munmap(r->rings, r->rings_len);
+    if (r->fd > 0)
+        close(r->fd);
+    memset(r, 0, sizeof(struct uring));
+}
+
+struct io_uring_sqe *uring_get_sqe(struct uring *r)
+{
+    struct io_uring_sqe *sqe;
+
+    /* ring full: hand it to the kernel first */
+    while (r->sq_local - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >
+           r->sq_mask)
+        if (uring_submit(r, 0) == -1)
+            return NULL;
+
+    sqe = &r->sqes[r->sq_local & r->sq_mask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    r->sq_local++;
+
+    return sqe;
+}
+
+int uring_submit(struct uring *r, int wait_ms)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned        to_submit;
+    int             ret;
+
+    to_submit = r->sq_local - *r->sq_tail;
+    __atomic_store_n(r->sq_tail, r->sq_local, __ATOMIC_RELEASE);
+
+    memset(&arg, 0, sizeof(arg));
+    ts.tv_sec = wait_ms / 1000;
+    ts.tv_nsec = (wait_ms % 1000) * 1000000L;
+    arg.ts = (uint64_t) (uintptr_t) & ts;
+
+    ret = uring_enter(r->fd, to_submit, wait_ms > 0 ? 1 : 0,
+                      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                      sizeof(arg));
+    if (ret == -1 && errno != ETIME && errno != EINTR && errno != EBUSY)
+    {
+        fprintf(stderr, "io_uring_enter() error: %d: %s\n", errno,
+                strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
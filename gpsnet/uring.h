@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014, Alexandru Csete <oz9aec@gmail.com>
+ * All rights reserved.
+ *
+ * This software is licensed under the terms and conditions of the
+ * Simplified BSD License. See license.txt for details.
+ *
+ */
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+/* Minimal io_uring on raw system calls, so that no liburing is needed */
+struct uring {
+    int             fd;
+    void           *rings;      /* SQ and CQ rings, one mapping */
+    size_t          rings_len;
+    struct io_uring_sqe *sqes;
+    size_t          sqes_len;
+
+    unsigned       *sq_head;
+    unsigned       *sq_tail;
+    unsigned        sq_mask;
+    unsigned        sq_local;   /* tail of SQEs not yet made visible */
+
+    unsigned       *cq_head;
+    unsigned       *cq_tail;
+    unsigned        cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+/** Set up a ring.
+ *  @param  r        The ring.
+ *  @param  entries  Number of submission entries.
+ *  @returns 0 on success, -1 if io_uring is missing or too old for
+ *           multishot accept and receive (Linux 6.0).
+ */
+int             uring_init(struct uring *r, unsigned entries);
+void            uring_exit(struct uring *r);
+
+/** Get a cleared submission entry, submitting the full ring if needed. */
+struct io_uring_sqe *uring_get_sqe(struct uring *r);
+
+/** Submit all entries and wait for a completion.
+ *  @param  r        The ring.
+ *  @param  wait_ms  Max time to wait in milliseconds, 0 to not wait.
+ *  @returns 0 on success or timeout, -1 on error.
+ */
+int             uring_submit(struct uring *r, int wait_ms);
+
+/** Get the next completion or NULL, uring_seen() releases it. */
+static inline struct io_uring_cqe *uring_peek(struct uring *r)
+{
+    unsigned        head = *r->cq_head;
+
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return &r->cqes[head & r->cq_mask];
+}
+
+static inline void uring_seen(struct uring *r)
+{
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#endif
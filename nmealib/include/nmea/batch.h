@@ -0,0 +1,68 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_BATCH_H__
+#define __NMEA_BATCH_H__
+
+#include "generator.h"
+
+#define NMEA_EPOCH_BUFF     (2048)  /**< Largest epoch written by the batch generator */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Independent generator instance with own random state and clock
+ * @see nmea_stream_init
+ * @see nmea_generate_batch
+ */
+typedef struct _nmeaGENSTREAM
+{
+    nmeaGENERATOR *gen; /**< Generator chain */
+    nmeaINFO    info;   /**< Current state of the instance */
+    nmeaRANDOM  rnd;    /**< Random state used by the generators */
+    double      utc;    /**< UTC of next epoch in seconds since 1970 */
+    double      period; /**< Time between epochs in seconds */
+
+} nmeaGENSTREAM;
+
+int     nmea_stream_init(
+        nmeaGENSTREAM *st,
+        int gen_type,               /* type of generator (NMEA_GEN_...) */
+        unsigned int seed,          /* seed of the random state */
+        double utc,                 /* UTC of first epoch (seconds since 1970) */
+        double period               /* time between epochs (seconds) */
+        );
+
+void    nmea_stream_destroy(nmeaGENSTREAM *st);
+
+int     nmea_stream_generate(
+        nmeaGENSTREAM *st,
+        char *buff, int buff_sz,    /* buffer */
+        int generate_mask           /* mask of sentence`s (e.g. GPGGA | GPGSA) */
+        );
+
+int     nmea_generate_batch(
+        nmeaGENSTREAM *streams,     /* generator instances */
+        int stream_count,
+        int epoch_count,            /* epochs per instance */
+        int generate_mask,          /* mask of sentence`s (e.g. GPGGA | GPGSA) */
+        char *buff, int buff_sz,    /* buffer */
+        int *stream_sz,             /* (O) bytes per instance, may be 0 */
+        int thread_count            /* worker threads, 0 - one per CPU */
+        );
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_BATCH_H__ */
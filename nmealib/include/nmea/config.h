@@ -36,9 +36,11 @@
 #if defined(_MSC_VER)
 # define NMEA_POSIX(x)  _##x
 # define NMEA_INLINE    __inline
+# define NMEA_TLS       __declspec(thread)
 #else
 # define NMEA_POSIX(x)  x
-# define NMEA_INLINE    inline
+# define NMEA_INLINE    __inline__  /* also in strict C89 */
+# define NMEA_TLS       __thread
 #endif
 
 #if !defined(NDEBUG) && !defined(NMEA_CE)
@@ -0,0 +1,81 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_ECEF_H__
+#define __NMEA_ECEF_H__
+
+#include "gmath.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Local east-north-up frame around a reference point
+ * @see nmea_enu_init
+ */
+typedef struct _nmeaENUREF
+{
+    double  lat;        /**< Latitude of reference in radians */
+    double  lon;        /**< Longitude of reference in radians */
+    double  h;          /**< Height of reference above WGS84 ellipsoid in meters */
+    double  x, y, z;    /**< Reference in ECEF meters */
+    double  rot[3][3];  /**< Rotation from ECEF to ENU, rows are east, north and up */
+
+} nmeaENUREF;
+
+/*
+ * All conversions work on arrays of count points, lat/lon in radians,
+ * heights above the WGS84 ellipsoid and coordinates in meters.
+ * Height arrays may be NULL (zero height on input, not stored on output).
+ */
+
+void    nmea_geodetic2ecef(
+        const double *lat, const double *lon, const double *h, int count,
+        double *x, double *y, double *z
+        );
+
+void    nmea_ecef2geodetic(
+        const double *x, const double *y, const double *z, int count,
+        double *lat, double *lon, double *h
+        );
+
+void    nmea_enu_init(nmeaENUREF *ref, double lat, double lon, double h);
+
+void    nmea_ecef2enu(
+        const nmeaENUREF *ref,
+        const double *x, const double *y, const double *z, int count,
+        double *e, double *n, double *u
+        );
+
+void    nmea_enu2ecef(
+        const nmeaENUREF *ref,
+        const double *e, const double *n, const double *u, int count,
+        double *x, double *y, double *z
+        );
+
+void    nmea_geodetic2enu(
+        const nmeaENUREF *ref,
+        const double *lat, const double *lon, const double *h, int count,
+        double *e, double *n, double *u
+        );
+
+void    nmea_enu2geodetic(
+        const nmeaENUREF *ref,
+        const double *e, const double *n, const double *u, int count,
+        double *lat, double *lon, double *h
+        );
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_ECEF_H__ */
@@ -46,6 +46,25 @@ int     nmea_generate_from(
         int generate_mask           /* mask of sentence`s (e.g. GPGGA | GPGSA) */
         );
 
+/*
+ * random values
+ */
+
+/**
+ * State of random generator (xoshiro128**), one per generator instance
+ * @see nmea_random_bind
+ */
+typedef struct _nmeaRANDOM
+{
+    unsigned int s[4];
+
+} nmeaRANDOM;
+
+double  nmea_random(double min, double max);
+void    nmea_random_seed(nmeaRANDOM *rnd, unsigned int seed);
+double  nmea_random_r(nmeaRANDOM *rnd, double min, double max);
+nmeaRANDOM * nmea_random_bind(nmeaRANDOM *rnd);
+
 /*
  * low level
  */
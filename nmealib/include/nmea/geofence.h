@@ -0,0 +1,137 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_GEOFENCE_H__
+#define __NMEA_GEOFENCE_H__
+
+#include "info.h"
+
+#define NMEA_GEOFENCE_CELL      (0.0002)    /**< Default grid cell in radians (about 1.3 km) */
+
+#define NMEA_FENCE_CIRCLE       (1)         /**< Fence is a circle */
+#define NMEA_FENCE_POLYGON      (2)         /**< Fence is a polygon */
+
+#define NMEA_FENCE_ENTER        (1)         /**< Event: fix is inside the fence */
+#define NMEA_FENCE_EXIT         (2)         /**< Event: fix is outside the fence */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One fence of the engine
+ * Polygon vertices are projected to a plane around origin once, when
+ * the fence is added.
+ */
+typedef struct _nmeaFENCE
+{
+    int     type;       /**< NMEA_FENCE_CIRCLE or NMEA_FENCE_POLYGON */
+    int     id;         /**< Id given by caller */
+    nmeaPOS origin;     /**< Circle center or projection origin in radians */
+    double  scale;      /**< Meters per radian of longitude at origin */
+    double  radius;     /**< Circle radius in meters */
+    int     first;      /**< First polygon vertex in the engine arrays */
+    int     count;      /**< Number of polygon vertices */
+    nmeaPOS min_pos;    /**< South west corner of bounding box */
+    nmeaPOS max_pos;    /**< North east corner of bounding box */
+
+} nmeaFENCE;
+
+/**
+ * Grid cell with the fences touching it
+ */
+typedef struct _nmeaFENCECELL
+{
+    int     lat;        /**< Cell row */
+    int     lon;        /**< Cell column */
+    int     first;      /**< First fence index in cell_fence */
+
+} nmeaFENCECELL;
+
+/**
+ * Geofence engine
+ * Fences are added, then nmea_geofence_build makes the grid index.
+ * The engine is read only afterwards and can be shared by threads,
+ * every tracked subject has its own nmeaFENCESTATE.
+ * @see nmea_geofence_init
+ */
+typedef struct _nmeaGEOFENCE
+{
+    double  margin;     /**< Hysteresis in meters */
+    double  cell;       /**< Grid cell size in radians */
+
+    nmeaFENCE *fence;   /**< Fences */
+    int     fence_count;
+    int     fence_size;
+
+    double *vx;         /**< Projected polygon vertices, east in meters */
+    double *vy;         /**< Projected polygon vertices, north in meters */
+    int     vertex_count;
+    int     vertex_size;
+
+    nmeaFENCECELL *cells; /**< Non empty cells sorted by row and column, plus end marker */
+    int     cell_count;
+    int    *cell_fence; /**< Fence indices of cells, ascending per cell */
+
+} nmeaGEOFENCE;
+
+/**
+ * Fences one subject (vehicle) is inside
+ */
+typedef struct _nmeaFENCESTATE
+{
+    int    *inside;     /**< Fence indices, ascending */
+    int     count;
+    int     size;
+
+} nmeaFENCESTATE;
+
+/**
+ * Enter or exit event
+ */
+typedef struct _nmeaFENCEEVENT
+{
+    int     id;         /**< Id of the fence */
+    int     type;       /**< NMEA_FENCE_ENTER or NMEA_FENCE_EXIT */
+    double  dist;       /**< Distance from the fence border, positive inside, meters */
+
+} nmeaFENCEEVENT;
+
+int     nmea_geofence_init(nmeaGEOFENCE *gf, double margin, double cell);
+void    nmea_geofence_destroy(nmeaGEOFENCE *gf);
+
+int     nmea_geofence_add_circle(
+        nmeaGEOFENCE *gf, int id,
+        const nmeaPOS *center, double radius
+        );
+
+int     nmea_geofence_add_polygon(
+        nmeaGEOFENCE *gf, int id,
+        const nmeaPOS *vertex, int count
+        );
+
+int     nmea_geofence_build(nmeaGEOFENCE *gf);
+
+void    nmea_fencestate_init(nmeaFENCESTATE *st);
+void    nmea_fencestate_destroy(nmeaFENCESTATE *st);
+
+int     nmea_geofence_check(
+        const nmeaGEOFENCE *gf,
+        nmeaFENCESTATE *st,
+        const nmeaPOS *pos,
+        nmeaFENCEEVENT *ev, int max_ev
+        );
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_GEOFENCE_H__ */
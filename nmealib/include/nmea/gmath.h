@@ -13,6 +13,8 @@
 
 #include "info.h"
 
+#include <math.h>
+
 #define NMEA_PI                     (3.141592653589793)             /**< PI value */
 #define NMEA_PI180                  (NMEA_PI / 180)                 /**< PI division by 180 */
 #define NMEA_EARTHRADIUS_KM         (6378)                          /**< Earth's mean radius in km */
@@ -21,11 +23,86 @@
 #define NMEA_EARTH_SEMIMAJORAXIS_KM (NMEA_EARTHMAJORAXIS_KM / 1000) /**< Earth's semi-major axis in km according WGS 84 */
 #define NMEA_EARTH_FLATTENING       (1 / 298.257223563)             /**< Earth's flattening according WGS 84 */
 #define NMEA_DOP_FACTOR             (5)                             /**< Factor for translating DOP to meters */
+#define NMEA_GEODESIC_STEPS         (20)                            /**< Iteration limit of the geodesic solvers */
+
+/*
+ * Inline versions of the conversions, loops calling them can be
+ * vectorized. Results are the same as of the exported functions.
+ * Define NMEA_GMATH_INLINE before including to make the exported
+ * names use them (the exported symbols stay in the library).
+ */
+
+static NMEA_INLINE double nmea_inl_degree2radian(double val)
+{ return (val * NMEA_PI180); }
+
+static NMEA_INLINE double nmea_inl_radian2degree(double val)
+{ return (val / NMEA_PI180); }
+
+static NMEA_INLINE double nmea_inl_ndeg2degree(double val)
+{
+    double deg = ((int)(val / 100));
+    return deg + (val - deg * 100) / 60;
+}
+
+static NMEA_INLINE double nmea_inl_degree2ndeg(double val)
+{
+    /* modf() without the call: the fraction has the sign of val, and
+       is zero for infinities */
+    double deg = trunc(val);
+    double fra = copysign(isinf(val) ? 0.0 : val - deg, val);
+    return deg * 100 + fra * 60;
+}
+
+static NMEA_INLINE double nmea_inl_ndeg2radian(double val)
+{ return nmea_inl_degree2radian(nmea_inl_ndeg2degree(val)); }
+
+static NMEA_INLINE double nmea_inl_radian2ndeg(double val)
+{ return nmea_inl_degree2ndeg(nmea_inl_radian2degree(val)); }
+
+static NMEA_INLINE double nmea_inl_calc_pdop(double hdop, double vdop)
+{ return sqrt(hdop * hdop + vdop * vdop); }
+
+static NMEA_INLINE double nmea_inl_dop2meters(double dop)
+{ return (dop * NMEA_DOP_FACTOR); }
+
+static NMEA_INLINE double nmea_inl_meters2dop(double meters)
+{ return (meters / NMEA_DOP_FACTOR); }
+
+#if defined(__cplusplus) && __cplusplus >= 201103L
+namespace nmea
+{
+    constexpr double degree2radian(double val) { return val * NMEA_PI180; }
+    constexpr double radian2degree(double val) { return val / NMEA_PI180; }
+    constexpr double ndeg2degree(double val)
+    { return (double)(int)(val / 100) + (val - (double)(int)(val / 100) * 100) / 60; }
+    constexpr double degree2ndeg(double val)
+    { return (double)(int)val * 100 + (val - (double)(int)val) * 60; }
+    constexpr double ndeg2radian(double val) { return degree2radian(ndeg2degree(val)); }
+    constexpr double radian2ndeg(double val) { return degree2ndeg(radian2degree(val)); }
+    constexpr double dop2meters(double dop) { return dop * NMEA_DOP_FACTOR; }
+    constexpr double meters2dop(double meters) { return meters / NMEA_DOP_FACTOR; }
+}
+#endif
 
 #ifdef  __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Geodesic context, WGS84 terms of a fixed origin
+ * @see nmea_geodesic_init
+ */
+typedef struct _nmeaGEODESIC
+{
+    nmeaPOS origin;     /**< Origin in radians */
+    double  tan_U1;     /**< Tangent of reduced latitude of origin */
+    double  sin_U1;     /**< Sine of reduced latitude of origin */
+    double  cos_U1;     /**< Cosine of reduced latitude of origin */
+    int     iterations; /**< Iterations done by the last call */
+    int     failed;     /**< Solutions of the last call which did not converge */
+
+} nmeaGEODESIC;
+
 /*
  * degree VS radian
  */
@@ -51,6 +128,18 @@ double nmea_calc_pdop(double hdop, double vdop);
 double nmea_dop2meters(double dop);
 double nmea_meters2dop(double meters);
 
+/*
+ * conversions of arrays, res may be the same as val
+ */
+
+void nmea_degree2radian_array(const double *val, double *res, int count);
+void nmea_radian2degree_array(const double *val, double *res, int count);
+void nmea_ndeg2degree_array(const double *val, double *res, int count);
+void nmea_degree2ndeg_array(const double *val, double *res, int count);
+void nmea_ndeg2radian_array(const double *val, double *res, int count);
+void nmea_radian2ndeg_array(const double *val, double *res, int count);
+void nmea_calc_pdop_array(const double *hdop, const double *vdop, double *pdop, int count);
+
 /*
  * positions work
  */
@@ -85,8 +174,93 @@ int     nmea_move_horz_ellipsoid(
         double *end_azimuth
         );
 
+/*
+ * positions work on arrays
+ */
+
+double  nmea_distance_track(
+        const double *lat,
+        const double *lon,
+        int count,
+        double *dist
+        );
+
+void    nmea_distance_one2many(
+        const nmeaPOS *from_pos,
+        const double *lat,
+        const double *lon,
+        int count,
+        double *dist
+        );
+
+void    nmea_distance_many2many(
+        const double *from_lat,
+        const double *from_lon,
+        int from_count,
+        const double *to_lat,
+        const double *to_lon,
+        int to_count,
+        double *dist
+        );
+
+/*
+ * geodesics from a fixed origin
+ */
+
+void    nmea_geodesic_init(
+        nmeaGEODESIC *geo,
+        const nmeaPOS *origin
+        );
+
+double  nmea_geodesic_inverse(
+        nmeaGEODESIC *geo,
+        const nmeaPOS *to_pos,
+        double *from_azimuth,
+        double *to_azimuth
+        );
+
+void    nmea_geodesic_inverse_many(
+        nmeaGEODESIC *geo,
+        const double *lat,
+        const double *lon,
+        int count,
+        double *dist,
+        double *from_azimuth,
+        double *to_azimuth
+        );
+
+int     nmea_geodesic_direct(
+        nmeaGEODESIC *geo,
+        double azimuth,
+        double distance,
+        nmeaPOS *end_pos,
+        double *end_azimuth
+        );
+
+int     nmea_geodesic_direct_many(
+        nmeaGEODESIC *geo,
+        const double *azimuth,
+        const double *distance,
+        int count,
+        double *lat,
+        double *lon,
+        double *end_azimuth
+        );
+
 #ifdef  __cplusplus
 }
 #endif
 
+#ifdef NMEA_GMATH_INLINE
+#   define nmea_degree2radian   nmea_inl_degree2radian
+#   define nmea_radian2degree   nmea_inl_radian2degree
+#   define nmea_ndeg2degree     nmea_inl_ndeg2degree
+#   define nmea_degree2ndeg     nmea_inl_degree2ndeg
+#   define nmea_ndeg2radian     nmea_inl_ndeg2radian
+#   define nmea_radian2ndeg     nmea_inl_radian2ndeg
+#   define nmea_calc_pdop       nmea_inl_calc_pdop
+#   define nmea_dop2meters      nmea_inl_dop2meters
+#   define nmea_meters2dop      nmea_inl_meters2dop
+#endif
+
 #endif /* __NMEA_GMATH_H__ */
@@ -0,0 +1,78 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_KDTREE_H__
+#define __NMEA_KDTREE_H__
+
+#include "info.h"
+
+#define NMEA_KDTREE_LEAF    (8)     /**< Largest subtree scanned without descending */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Static k-d tree over ECEF coordinates of track points
+ * Points are stored in tree order, node of range [lo, hi) is the median
+ * point lo + (hi - lo) / 2. Every node also keeps the latitude and
+ * longitude bounds of its subtree for box queries.
+ * @see nmea_kdtree_build
+ */
+typedef struct _nmeaKDTREE
+{
+    int     count;      /**< Number of points */
+    double *x;          /**< ECEF x in meters */
+    double *y;          /**< ECEF y in meters */
+    double *z;          /**< ECEF z in meters */
+    double *lat;        /**< Latitude in radians */
+    double *lon;        /**< Longitude in radians */
+    double *bound;      /**< Subtree bounds of node: min lat, min lon, max lat, max lon */
+    int    *id;         /**< Index of point in the arrays given to nmea_kdtree_build */
+    unsigned char *axis; /**< Split axis of node (0 - x, 1 - y, 2 - z) */
+
+} nmeaKDTREE;
+
+int     nmea_kdtree_build(
+        nmeaKDTREE *tree,
+        const double *lat, const double *lon, const double *h, /* h may be NULL */
+        int count
+        );
+
+void    nmea_kdtree_destroy(nmeaKDTREE *tree);
+
+int     nmea_kdtree_nearest(
+        const nmeaKDTREE *tree,
+        const nmeaPOS *pos, double h,
+        int k,
+        int *ids,                   /* (O) point indices, nearest first */
+        double *dist                /* (O) distances in meters */
+        );
+
+int     nmea_kdtree_radius(
+        const nmeaKDTREE *tree,
+        const nmeaPOS *pos, double h,
+        double radius,
+        int *ids, int max_ids       /* (O) point indices */
+        );
+
+int     nmea_kdtree_bbox(
+        const nmeaKDTREE *tree,
+        const nmeaPOS *min_pos,     /* south west corner */
+        const nmeaPOS *max_pos,     /* north east corner */
+        int *ids, int max_ids       /* (O) point indices */
+        );
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_KDTREE_H__ */
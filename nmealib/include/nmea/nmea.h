@@ -14,6 +14,7 @@
 #include "./config.h"
 #include "./units.h"
 #include "./gmath.h"
+#include "./ecef.h"
 #include "./info.h"
 #include "./sentence.h"
 #include "./generate.h"
@@ -21,5 +22,13 @@
 #include "./parse.h"
 #include "./parser.h"
 #include "./context.h"
+#include "./batch.h"
+#include "./track.h"
+#include "./kdtree.h"
+#include "./simplify.h"
+#include "./geofence.h"
+#include "./proximity.h"
+#include "./resample.h"
+#include "./predict.h"
 
 #endif /* __NMEA_H__ */
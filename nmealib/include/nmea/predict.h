@@ -0,0 +1,60 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_PREDICT_H__
+#define __NMEA_PREDICT_H__
+
+#include "info.h"
+
+#define NMEA_PREDICT_CV         (0)     /**< Constant velocity */
+#define NMEA_PREDICT_CTRV       (1)     /**< Constant turn rate and velocity */
+
+#define NMEA_PREDICT_HORIZON    (5.0)   /**< Default longest extrapolation in seconds */
+#define NMEA_PREDICT_MIN_SPEED  (1.0)   /**< Below this speed (km/h) direction is noise, no turn rate */
+#define NMEA_PREDICT_MAX_TURN   (1.0)   /**< Limit of turn rate in radians per second */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Extrapolation of the receiver position between fixes
+ * Times are seconds of a monotonic clock of the caller. A fix is taken
+ * as valid latency seconds before the time it was received.
+ * @see nmea_predict_init
+ */
+typedef struct _nmeaPREDICT
+{
+    int     model;      /**< NMEA_PREDICT_CV or NMEA_PREDICT_CTRV */
+    double  latency;    /**< Receiver output delay in seconds */
+    double  horizon;    /**< Longest extrapolation in seconds */
+
+    int     count;      /**< Fixes taken */
+    nmeaPOS pos;        /**< Last fix in radians */
+    double  time;       /**< Monotonic time the last fix is valid at */
+    double  utc;        /**< UTC of the last fix in seconds */
+    double  speed;      /**< Speed in m/s */
+    double  direction;  /**< Track angle in radians */
+    double  turn;       /**< Turn rate in radians per second, clockwise */
+    double  pos_err;    /**< Error of the fix in meters */
+    double  acc_err;    /**< Growth of error in m/s^2, from past predictions */
+
+} nmeaPREDICT;
+
+void    nmea_predict_init(nmeaPREDICT *pr, int model);
+int     nmea_predict_add_info(nmeaPREDICT *pr, const nmeaINFO *info, double time);
+int     nmea_predict(const nmeaPREDICT *pr, double time, nmeaPOS *pos, double *err);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_PREDICT_H__ */
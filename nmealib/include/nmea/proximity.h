@@ -0,0 +1,72 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_PROXIMITY_H__
+#define __NMEA_PROXIMITY_H__
+
+#include "info.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Pair of units closer than the threshold
+ */
+typedef struct _nmeaPROXPAIR
+{
+    int     a;          /**< Lower unit number */
+    int     b;          /**< Higher unit number */
+    double  dist;       /**< Straight line distance in meters */
+
+} nmeaPROXPAIR;
+
+/**
+ * Latest positions of a fleet and a spatial hash over them
+ * Units are numbered 0 .. size - 1 by the caller. Positions are hashed
+ * into ECEF cubes with the edge of the threshold, so only units in
+ * neighbouring cubes are compared.
+ * @see nmea_proximity_init
+ */
+typedef struct _nmeaPROXIMITY
+{
+    double  threshold;  /**< Distance in meters */
+    int     size;       /**< Number of units */
+    int     table_size; /**< Hash buckets, power of two */
+
+    char   *valid;      /**< Unit has a position */
+    double *lat;        /**< Latest latitude in radians */
+    double *lon;        /**< Latest longitude in radians */
+    double *h;          /**< Latest height in meters */
+
+    double *x;          /**< Work: ECEF of units */
+    double *y;
+    double *z;
+    int    *cell;       /**< Work: cube of units, 3 per unit */
+    int    *head;       /**< Work: first entry of buckets in order, table_size + 1 */
+    int    *order;      /**< Work: units sorted by bucket */
+
+} nmeaPROXIMITY;
+
+int     nmea_proximity_init(nmeaPROXIMITY *px, double threshold, int size);
+void    nmea_proximity_destroy(nmeaPROXIMITY *px);
+
+void    nmea_proximity_update(nmeaPROXIMITY *px, int unit, const nmeaINFO *info);
+void    nmea_proximity_set(nmeaPROXIMITY *px, int unit, const nmeaPOS *pos, double h);
+void    nmea_proximity_remove(nmeaPROXIMITY *px, int unit);
+
+int     nmea_proximity_pairs(nmeaPROXIMITY *px, nmeaPROXPAIR *pairs, int max_pairs);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_PROXIMITY_H__ */
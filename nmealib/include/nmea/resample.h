@@ -0,0 +1,47 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_RESAMPLE_H__
+#define __NMEA_RESAMPLE_H__
+
+#include "info.h"
+
+#define NMEA_RESAMPLE_LINEAR    (0)     /**< Straight lines between fixes */
+#define NMEA_RESAMPLE_HERMITE   (1)     /**< Cubic Hermite, continuous velocity */
+
+#define NMEA_RESAMPLE_GAP       (1)     /**< Flag: sample in a gap, linear */
+#define NMEA_RESAMPLE_OUTSIDE   (2)     /**< Flag: sample before first or after last fix, held */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+int     nmea_resample(
+        const double *utc,          /* fix times in seconds, ascending (nmea_time2sec) */
+        const double *lat,          /* fix latitudes in radians */
+        const double *lon,          /* fix longitudes in radians */
+        const double *ve,           /* fix east velocities in m/s or NULL */
+        const double *vn,           /* fix north velocities in m/s or NULL */
+        int count,
+        double start, double step,  /* output grid in seconds */
+        int out_count,
+        double max_gap,             /* longest interval interpolated, 0 - no limit */
+        int method,                 /* NMEA_RESAMPLE_LINEAR or NMEA_RESAMPLE_HERMITE */
+        double *out_lat, double *out_lon,
+        double *out_ve, double *out_vn, /* may be NULL */
+        int *out_flags              /* may be NULL */
+        );
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_RESAMPLE_H__ */
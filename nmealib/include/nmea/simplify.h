@@ -0,0 +1,74 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_SIMPLIFY_H__
+#define __NMEA_SIMPLIFY_H__
+
+#include "info.h"
+
+#define NMEA_SIMPLIFY_LEVELS    (8)     /**< Max number of tolerances */
+#define NMEA_SIMPLIFY_WINDOW    (1024)  /**< Default number of points held */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Point kept by the simplifier
+ */
+typedef struct _nmeaSIMPLEPOINT
+{
+    nmeaPOS pos;        /**< Position in radians */
+    long    index;      /**< Number of the point in the input, from 0 */
+    int     levels;     /**< Bit i is set if the point is kept at tolerance i */
+
+} nmeaSIMPLEPOINT;
+
+/**
+ * Streaming Douglas-Peucker simplifier
+ * Holds at most window points, so memory does not depend on the length
+ * of the track.
+ * @see nmea_simplify_init
+ */
+typedef struct _nmeaSIMPLIFY
+{
+    double  tolerance[NMEA_SIMPLIFY_LEVELS]; /**< Tolerances in meters, ascending */
+    int     levels;     /**< Number of tolerances */
+    int     window;     /**< Max number of points held */
+    int     count;      /**< Points held now */
+    long    index;      /**< Number of next input point */
+
+    nmeaSIMPLEPOINT *out; /**< Points emitted by the last call */
+    nmeaSIMPLEPOINT *pt;  /**< Points held */
+    double *e;          /**< Work: east of held points */
+    double *n;          /**< Work: north of held points */
+    double *sig;        /**< Work: significance of held points */
+    int    *stack;      /**< Work: ranges of the split */
+
+} nmeaSIMPLIFY;
+
+int     nmea_simplify_init(
+        nmeaSIMPLIFY *s,
+        const double *tolerance,    /* tolerances in meters, ascending */
+        int levels,                 /* number of tolerances */
+        int window                  /* points held, 0 - NMEA_SIMPLIFY_WINDOW */
+        );
+
+void    nmea_simplify_destroy(nmeaSIMPLIFY *s);
+
+int     nmea_simplify_add(nmeaSIMPLIFY *s, const nmeaPOS *pos);
+int     nmea_simplify_finish(nmeaSIMPLIFY *s);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_SIMPLIFY_H__ */
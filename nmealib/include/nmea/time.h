@@ -40,6 +40,16 @@ typedef struct _nmeaTIME
  */
 void nmea_time_now(nmeaTIME *t);
 
+/**
+ * \brief Convert nmeaTIME to seconds since 1970-01-01 00:00:00 UTC
+ */
+double nmea_time2sec(const nmeaTIME *t);
+
+/**
+ * \brief Convert seconds since 1970-01-01 00:00:00 UTC to nmeaTIME
+ */
+void nmea_sec2time(double sec, nmeaTIME *t);
+
 #ifdef  __cplusplus
 }
 #endif
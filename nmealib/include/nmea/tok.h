@@ -17,12 +17,32 @@
 extern "C" {
 #endif
 
+/**
+ * Sentence writer state used by the hand-rolled generators
+ * @see nmea_fmt_begin
+ */
+typedef struct _nmeaFMT
+{
+    char   *buff;       /**< Output buffer */
+    int     buff_sz;    /**< Output buffer size */
+    int     len;        /**< Number of bytes written */
+    int     crc;        /**< Running control sum of the bytes after '$' */
+    int     error;      /**< Field can not be written exactly, caller must fall back to nmea_printf */
+
+} nmeaFMT;
+
 int     nmea_calc_crc(const char *buff, int buff_sz);
 int     nmea_atoi(const char *str, int str_sz, int radix);
 double  nmea_atof(const char *str, int str_sz);
 int     nmea_printf(char *buff, int buff_sz, const char *format, ...);
 int     nmea_scanf(const char *buff, int buff_sz, const char *format, ...);
 
+void    nmea_fmt_begin(nmeaFMT *fmt, char *buff, int buff_sz, const char *head);
+void    nmea_fmt_char(nmeaFMT *fmt, int ch);
+void    nmea_fmt_int(nmeaFMT *fmt, int val, int width);
+void    nmea_fmt_fixed(nmeaFMT *fmt, double val, int width, int prec);
+int     nmea_fmt_end(nmeaFMT *fmt);
+
 #ifdef  __cplusplus
 }
 #endif
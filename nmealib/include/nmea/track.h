@@ -0,0 +1,73 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file */
+
+#ifndef __NMEA_TRACK_H__
+#define __NMEA_TRACK_H__
+
+#include "info.h"
+
+#define NMEA_TRACK_MOVING_SPEED (1.0)   /**< Default speed (km/h) above which a leg counts as moving */
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Running statistics of a track
+ * Every field is updated in constant time per fix, statistics of track
+ * pieces collected separately can be joined by nmea_track_merge.
+ * Positions are in radians, UTC in seconds since 1970.
+ * @see nmea_track_init
+ */
+typedef struct _nmeaTRACKSTAT
+{
+    int     count;          /**< Fixes added */
+    int     pos_count;      /**< Fixes with position */
+    int     elv_count;      /**< Fixes with elevation */
+    int     sig_count[NMEA_SIG_HIGH + 1]; /**< Fixes per GPS quality indicator (NMEA_SIG_...) */
+    int     fix_count[NMEA_FIX_3D + 1]; /**< Fixes per operating mode (NMEA_FIX_...) */
+
+    double  first_utc;      /**< UTC of first fix with position */
+    double  last_utc;       /**< UTC of last fix with position */
+    nmeaPOS first_pos;      /**< First position */
+    nmeaPOS last_pos;       /**< Last position */
+    nmeaPOS min_pos;        /**< South west corner of bounding box */
+    nmeaPOS max_pos;        /**< North east corner of bounding box */
+
+    double  distance;       /**< Odometer in meters */
+    double  moving_time;    /**< Seconds of legs faster than moving_speed */
+    double  max_speed;      /**< Largest speed in km/h */
+
+    double  first_elv;      /**< First elevation in meters */
+    double  last_elv;       /**< Last elevation in meters */
+    double  min_elv;        /**< Lowest elevation in meters */
+    double  max_elv;        /**< Highest elevation in meters */
+    double  elv_gain;       /**< Total climb in meters */
+    double  elv_loss;       /**< Total descent in meters */
+    double  elv_ref;        /**< Elevation the next climb or descent is counted from */
+
+    double  moving_speed;   /**< Setting: speed (km/h) above which a leg counts as moving */
+    double  elv_hyst;       /**< Setting: elevation change (m) ignored as noise */
+
+} nmeaTRACKSTAT;
+
+void    nmea_track_init(nmeaTRACKSTAT *st);
+void    nmea_track_add_info(nmeaTRACKSTAT *st, const nmeaINFO *info);
+void    nmea_track_add_pos(nmeaTRACKSTAT *st, const nmeaPOS *pos, double utc);
+void    nmea_track_merge(nmeaTRACKSTAT *st, const nmeaTRACKSTAT *src);
+
+double  nmea_track_mean_speed(const nmeaTRACKSTAT *st);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* __NMEA_TRACK_H__ */
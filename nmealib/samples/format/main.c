@@ -0,0 +1,302 @@
+/*
+ * Compare the sentence generators with the nmea_printf() formatting they
+ * replaced, for random packets and for the cases the direct writer hands
+ * back to nmea_printf(). Exits with 1 if any output differs.
+ */
+
+#include <nmea/nmea.h>
+#include <nmea/tok.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NUM_RANDOM  200000
+#define MAX_SHOWN   10
+#define BUFF_SIZE   256
+
+static unsigned int seed = 12345;
+static int failed = 0;
+
+static unsigned int next_rand(void)
+{
+    /* xorshift, the same sequence on every platform */
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static int rand_below(int n)
+{
+    return (int)(next_rand() % (unsigned int)n);
+}
+
+static const double edge_double[] = {
+    0.0, -0.0, 0.05, 0.15, 0.25, 0.35, 0.45, 0.75, 1.25, 2.5, -0.05, -0.25,
+    -0.04, -0.01, 0.00005, 0.00015, 0.00025, 4916.45, 4916.00005, 9.95,
+    99.95, 999.95, 1e15, 1e17, 1e19, -1e19, 1e300, -1e300, DBL_MAX,
+    -DBL_MAX, DBL_MIN, 5e-324
+};
+
+static double rand_double(int prec)
+{
+    double p = pow(10, prec);
+    unsigned long long bits;
+
+    switch(rand_below(8))
+    {
+    case 0:
+        return edge_double[rand_below(sizeof(edge_double) / sizeof(double))];
+    case 1:
+        switch(rand_below(4))
+        {
+        case 0: return NAN;
+        case 1: return -NAN;
+        case 2: return INFINITY;
+        default: return -INFINITY;
+        }
+    case 2:
+        /* a tie at the printed precision, exact in binary or not */
+        return (rand_below(20000) + 0.5) / p * (rand_below(2) ? 1 : -1);
+    case 3:
+        bits = ((unsigned long long)next_rand() << 32) | next_rand();
+        {
+            double val;
+            memcpy(&val, &bits, sizeof(val));
+            return val;
+        }
+    case 4:
+        return (double)rand_below(1000000) / 100 - 5000;
+    default:
+        return (double)next_rand() / UINT_MAX * 18000;
+    }
+}
+
+static int rand_int(int max)
+{
+    switch(rand_below(10))
+    {
+    case 0:
+        return (int)next_rand();
+    case 1:
+        return rand_below(2) ? INT_MIN : INT_MAX;
+    case 2:
+        return -rand_below(max + 1);
+    default:
+        return rand_below(max + 1);
+    }
+}
+
+static char rand_char(void)
+{
+    static const char usual[] = "NSEWAVMDTKn";
+
+    if(rand_below(10) == 0)
+        return (char)rand_below(256);   /* non-ASCII and NUL */
+    return usual[rand_below(sizeof(usual) - 1)];
+}
+
+static int rand_size(void)
+{
+    /* too small now and then, down to nothing */
+    return rand_below(10) == 0 ? rand_below(100) : BUFF_SIZE;
+}
+
+static void rand_time(nmeaTIME *t)
+{
+    /* the generators offset these, keep them clear of overflow */
+    t->year = rand_below(400) - 100;
+    t->mon = rand_below(40) - 20;
+    t->day = rand_int(31);
+    t->hour = rand_int(23);
+    t->min = rand_int(59);
+    t->sec = rand_int(59);
+    t->hsec = rand_int(99);
+}
+
+static void compare(const char *name, const char *got, int got_len,
+                    const char *want, int want_len)
+{
+    if(got_len == want_len && 0 == memcmp(got, want, want_len))
+        return;
+
+    if(failed++ < MAX_SHOWN)
+    {
+        printf("%s differs:\n  got  %d: %.*s\n  want %d: %.*s\n", name,
+            got_len, got_len > 0 ? got_len : 0, got,
+            want_len, want_len > 0 ? want_len : 0, want);
+    }
+}
+
+static void check_GPGGA(void)
+{
+    nmeaGPGGA pack;
+    char got[BUFF_SIZE], want[BUFF_SIZE];
+    int size = rand_size(), got_len, want_len;
+
+    rand_time(&pack.utc);
+    pack.lat = rand_double(4);
+    pack.ns = rand_char();
+    pack.lon = rand_double(4);
+    pack.ew = rand_char();
+    pack.sig = rand_int(3);
+    pack.satinuse = rand_int(12);
+    pack.HDOP = rand_double(1);
+    pack.elv = rand_double(1);
+    pack.elv_units = rand_char();
+    pack.diff = rand_double(1);
+    pack.diff_units = rand_char();
+    pack.dgps_age = rand_double(1);
+    pack.dgps_sid = rand_int(1023);
+
+    got_len = nmea_gen_GPGGA(got, size, &pack);
+    want_len = nmea_printf(want, size,
+        "$GPGGA,%02d%02d%02d.%02d,%07.4f,%C,%07.4f,%C,%1d,%02d,%03.1f,%03.1f,%C,%03.1f,%C,%03.1f,%04d",
+        pack.utc.hour, pack.utc.min, pack.utc.sec, pack.utc.hsec,
+        pack.lat, pack.ns, pack.lon, pack.ew,
+        pack.sig, pack.satinuse, pack.HDOP, pack.elv, pack.elv_units,
+        pack.diff, pack.diff_units, pack.dgps_age, pack.dgps_sid);
+
+    compare("GPGGA", got, got_len, want, want_len);
+}
+
+static void check_GPGSA(void)
+{
+    nmeaGPGSA pack;
+    char got[BUFF_SIZE], want[BUFF_SIZE];
+    int size = rand_size(), got_len, want_len, it;
+
+    pack.fix_mode = rand_char();
+    pack.fix_type = rand_int(3);
+    for(it = 0; it < NMEA_MAXSAT; ++it)
+        pack.sat_prn[it] = rand_int(99);
+    pack.PDOP = rand_double(1);
+    pack.HDOP = rand_double(1);
+    pack.VDOP = rand_double(1);
+
+    got_len = nmea_gen_GPGSA(got, size, &pack);
+    want_len = nmea_printf(want, size,
+        "$GPGSA,%C,%1d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%03.1f,%03.1f,%03.1f",
+        pack.fix_mode, pack.fix_type,
+        pack.sat_prn[0], pack.sat_prn[1], pack.sat_prn[2], pack.sat_prn[3], pack.sat_prn[4], pack.sat_prn[5],
+        pack.sat_prn[6], pack.sat_prn[7], pack.sat_prn[8], pack.sat_prn[9], pack.sat_prn[10], pack.sat_prn[11],
+        pack.PDOP, pack.HDOP, pack.VDOP);
+
+    compare("GPGSA", got, got_len, want, want_len);
+}
+
+static void check_GPGSV(void)
+{
+    nmeaGPGSV pack;
+    char got[BUFF_SIZE], want[BUFF_SIZE];
+    int size = rand_size(), got_len, want_len, it;
+
+    pack.pack_count = rand_int(3);
+    pack.pack_index = rand_below(40) - 20;   /* printed plus one */
+    pack.sat_count = rand_int(12);
+    for(it = 0; it < NMEA_SATINPACK; ++it)
+    {
+        pack.sat_data[it].id = rand_int(99);
+        pack.sat_data[it].in_use = rand_int(1);
+        pack.sat_data[it].elv = rand_int(90);
+        pack.sat_data[it].azimuth = rand_int(359);
+        pack.sat_data[it].sig = rand_int(99);
+    }
+
+    got_len = nmea_gen_GPGSV(got, size, &pack);
+    want_len = nmea_printf(want, size,
+        "$GPGSV,%1d,%1d,%02d,"
+        "%02d,%02d,%03d,%02d,"
+        "%02d,%02d,%03d,%02d,"
+        "%02d,%02d,%03d,%02d,"
+        "%02d,%02d,%03d,%02d",
+        pack.pack_count, pack.pack_index + 1, pack.sat_count,
+        pack.sat_data[0].id, pack.sat_data[0].elv, pack.sat_data[0].azimuth, pack.sat_data[0].sig,
+        pack.sat_data[1].id, pack.sat_data[1].elv, pack.sat_data[1].azimuth, pack.sat_data[1].sig,
+        pack.sat_data[2].id, pack.sat_data[2].elv, pack.sat_data[2].azimuth, pack.sat_data[2].sig,
+        pack.sat_data[3].id, pack.sat_data[3].elv, pack.sat_data[3].azimuth, pack.sat_data[3].sig);
+
+    compare("GPGSV", got, got_len, want, want_len);
+}
+
+static void check_GPRMC(void)
+{
+    nmeaGPRMC pack;
+    char got[BUFF_SIZE], want[BUFF_SIZE];
+    int size = rand_size(), got_len, want_len;
+
+    rand_time(&pack.utc);
+    pack.status = rand_char();
+    pack.lat = rand_double(4);
+    pack.ns = rand_char();
+    pack.lon = rand_double(4);
+    pack.ew = rand_char();
+    pack.speed = rand_double(1);
+    pack.direction = rand_double(1);
+    pack.declination = rand_double(1);
+    pack.declin_ew = rand_char();
+    pack.mode = rand_char();
+
+    got_len = nmea_gen_GPRMC(got, size, &pack);
+    want_len = nmea_printf(want, size,
+        "$GPRMC,%02d%02d%02d.%02d,%C,%07.4f,%C,%07.4f,%C,%03.1f,%03.1f,%02d%02d%02d,%03.1f,%C,%C",
+        pack.utc.hour, pack.utc.min, pack.utc.sec, pack.utc.hsec,
+        pack.status, pack.lat, pack.ns, pack.lon, pack.ew,
+        pack.speed, pack.direction,
+        pack.utc.day, pack.utc.mon + 1, pack.utc.year - 100,
+        pack.declination, pack.declin_ew, pack.mode);
+
+    compare("GPRMC", got, got_len, want, want_len);
+}
+
+static void check_GPVTG(void)
+{
+    nmeaGPVTG pack;
+    char got[BUFF_SIZE], want[BUFF_SIZE];
+    int size = rand_size(), got_len, want_len;
+
+    pack.dir = rand_double(1);
+    pack.dir_t = rand_char();
+    pack.dec = rand_double(1);
+    pack.dec_m = rand_char();
+    pack.spn = rand_double(1);
+    pack.spn_n = rand_char();
+    pack.spk = rand_double(1);
+    pack.spk_k = rand_char();
+
+    got_len = nmea_gen_GPVTG(got, size, &pack);
+    want_len = nmea_printf(want, size,
+        "$GPVTG,%.1f,%C,%.1f,%C,%.1f,%C,%.1f,%C",
+        pack.dir, pack.dir_t,
+        pack.dec, pack.dec_m,
+        pack.spn, pack.spn_n,
+        pack.spk, pack.spk_k);
+
+    compare("GPVTG", got, got_len, want, want_len);
+}
+
+int main()
+{
+    int it;
+
+    for(it = 0; it < NUM_RANDOM; ++it)
+    {
+        check_GPGGA();
+        check_GPGSA();
+        check_GPGSV();
+        check_GPRMC();
+        check_GPVTG();
+    }
+
+    if(failed)
+    {
+        printf("%d of %d sentences differ\n", failed, 5 * NUM_RANDOM);
+        return 1;
+    }
+
+    printf("%d sentences identical\n", 5 * NUM_RANDOM);
+
+    return 0;
+}
@@ -0,0 +1,263 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file batch.h */
+
+#include "nmea/batch.h"
+#include "nmea/generate.h"
+#include "nmea/context.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef NMEA_WIN
+#   pragma warning(disable: 4201)
+#   pragma warning(disable: 4214)
+#   pragma warning(disable: 4115)
+#   include <windows.h>
+#   pragma warning(default: 4201)
+#   pragma warning(default: 4214)
+#   pragma warning(default: 4115)
+#else
+#   include <pthread.h>
+#   include <unistd.h>
+#endif
+
+#define NMEA_BATCH_MAXTHREADS   (64)
+
+typedef struct _nmeaBATCHJOB
+{
+    nmeaGENSTREAM  *streams;
+    int             stream_count;
+    int             epoch_count;
+    int             generate_mask;
+    char           *buff;
+    int             slice_sz;
+    int            *stream_sz;
+
+} nmeaBATCHJOB;
+
+/**
+ * \brief Create generator instance
+ * The generator chain runs on its own random state, and the UTC of
+ * every epoch comes from utc + n * period instead of the system clock,
+ * so the same seed always gives the same stream.
+ * \return 1 - success, 0 - error
+ */
+int nmea_stream_init(
+        nmeaGENSTREAM *st,
+        int gen_type,
+        unsigned int seed,
+        double utc,
+        double period
+        )
+{
+    nmeaRANDOM *prev;
+
+    memset(st, 0, sizeof(nmeaGENSTREAM));
+    nmea_random_seed(&st->rnd, seed);
+    st->utc = utc;
+    st->period = period;
+
+    prev = nmea_random_bind(&st->rnd);
+    st->gen = nmea_create_generator(gen_type, &st->info);
+    nmea_random_bind(prev);
+
+    return (0 != st->gen);
+}
+
+void nmea_stream_destroy(nmeaGENSTREAM *st)
+{
+    if(st->gen)
+        nmea_destroy_generator(st->gen);
+    st->gen = 0;
+}
+
+/**
+ * \brief Generate next epoch of the instance
+ * \return Number of bytes written
+ */
+int nmea_stream_generate(
+        nmeaGENSTREAM *st,
+        char *buff, int buff_sz,
+        int generate_mask
+        )
+{
+    nmeaRANDOM *prev = nmea_random_bind(&st->rnd);
+    int retval;
+
+    if(0 != (retval = nmea_gen_loop(st->gen, &st->info)))
+    {
+        nmea_sec2time(st->utc, &st->info.utc);
+        st->utc += st->period;
+        retval = nmea_generate(buff, buff_sz, &st->info, generate_mask);
+    }
+
+    nmea_random_bind(prev);
+
+    return retval;
+}
+
+static void nmea_batch_run(nmeaBATCHJOB *job)
+{
+    char *slice;
+    int sit, eit, used;
+
+    for(sit = 0; sit < job->stream_count; ++sit)
+    {
+        slice = job->buff + (size_t)sit * job->slice_sz;
+
+        for(eit = 0, used = 0; eit < job->epoch_count; ++eit)
+        {
+            /* whole epochs only: stop before generating an epoch that might
+               not fit, so that the stream does not move past a lost one */
+            if(job->slice_sz - used < NMEA_EPOCH_BUFF)
+                break;
+            used += nmea_stream_generate(
+                &job->streams[sit], slice + used, NMEA_EPOCH_BUFF, job->generate_mask);
+        }
+
+        job->stream_sz[sit] = used;
+    }
+}
+
+#ifdef NMEA_WIN
+
+static DWORD WINAPI nmea_batch_thread(LPVOID arg)
+{
+    nmea_batch_run((nmeaBATCHJOB *)arg);
+    return 0;
+}
+
+static int nmea_batch_cpus(void)
+{
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+}
+
+#else /* NMEA_WIN */
+
+static void * nmea_batch_thread(void *arg)
+{
+    nmea_batch_run((nmeaBATCHJOB *)arg);
+    return 0;
+}
+
+static int nmea_batch_cpus(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return (cpus > 0)?(int)cpus:1;
+}
+
+#endif /* NMEA_WIN */
+
+/**
+ * \brief Generate epoch_count epochs for every instance
+ * The buffer is divided into equal slices, one per instance, and the
+ * instances are divided between threads. When all threads are done the
+ * slices are packed together in instance order. An instance stops early
+ * when its slice has less than NMEA_EPOCH_BUFF bytes left; its next epoch
+ * is then the first one of the next call.
+ * \return Number of bytes written
+ */
+int nmea_generate_batch(
+        nmeaGENSTREAM *streams,
+        int stream_count,
+        int epoch_count,
+        int generate_mask,
+        char *buff, int buff_sz,
+        int *stream_sz,
+        int thread_count
+        )
+{
+    nmeaBATCHJOB jobs[NMEA_BATCH_MAXTHREADS];
+#ifdef NMEA_WIN
+    HANDLE threads[NMEA_BATCH_MAXTHREADS];
+#else
+    pthread_t threads[NMEA_BATCH_MAXTHREADS];
+#endif
+    int started[NMEA_BATCH_MAXTHREADS];
+    int *sizes = stream_sz;
+    int it, first, per_thread, extra, slice_sz, total = 0;
+
+    if(!buff || stream_count <= 0 || buff_sz <= 0)
+        return 0;
+
+    if(!sizes && 0 == (sizes = malloc(stream_count * sizeof(int))))
+    {
+        nmea_error("Insufficient memory!");
+        return 0;
+    }
+
+    if(thread_count <= 0)
+        thread_count = nmea_batch_cpus();
+    if(thread_count > NMEA_BATCH_MAXTHREADS)
+        thread_count = NMEA_BATCH_MAXTHREADS;
+    if(thread_count > stream_count)
+        thread_count = stream_count;
+
+    slice_sz = buff_sz / stream_count;
+    per_thread = stream_count / thread_count;
+    extra = stream_count % thread_count;
+
+    /* the first jobs take one instance more, none is left empty */
+    for(it = 0, first = 0; it < thread_count; ++it)
+    {
+        jobs[it].streams = streams + first;
+        jobs[it].stream_count = per_thread + (it < extra);
+        jobs[it].epoch_count = epoch_count;
+        jobs[it].generate_mask = generate_mask;
+        jobs[it].buff = buff + (size_t)first * slice_sz;
+        jobs[it].slice_sz = slice_sz;
+        jobs[it].stream_sz = sizes + first;
+
+        /* last job runs in the calling thread */
+        if(it == thread_count - 1)
+            started[it] = 0;
+#ifdef NMEA_WIN
+        else
+            started[it] = (0 != (threads[it] = CreateThread(0, 0, &nmea_batch_thread, &jobs[it], 0, 0)));
+#else
+        else
+            started[it] = (0 == pthread_create(&threads[it], 0, &nmea_batch_thread, &jobs[it]));
+#endif
+
+        first += jobs[it].stream_count;
+    }
+
+    for(it = 0; it < thread_count; ++it)
+    {
+        if(!started[it])
+            nmea_batch_run(&jobs[it]);
+    }
+
+    for(it = 0; it < thread_count; ++it)
+    {
+        if(!started[it])
+            continue;
+#ifdef NMEA_WIN
+        WaitForSingleObject(threads[it], INFINITE);
+        CloseHandle(threads[it]);
+#else
+        pthread_join(threads[it], 0);
+#endif
+    }
+
+    for(it = 0; it < stream_count; ++it)
+    {
+        memmove(buff + total, buff + (size_t)it * slice_sz, sizes[it]);
+        total += sizes[it];
+    }
+
+    if(sizes != stream_sz)
+        free(sizes);
+
+    return total;
+}
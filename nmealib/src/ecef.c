@@ -0,0 +1,229 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file ecef.h */
+
+#include "nmea/ecef.h"
+#include "vmath.h"
+
+#include <math.h>
+
+#define NMEA_ECEF_A     (NMEA_EARTH_SEMIMAJORAXIS_M)
+#define NMEA_ECEF_B     ((1 - NMEA_EARTH_FLATTENING) * NMEA_EARTH_SEMIMAJORAXIS_M)
+#define NMEA_ECEF_E2    (NMEA_EARTH_FLATTENING * (2 - NMEA_EARTH_FLATTENING))
+#define NMEA_ECEF_BLOCK (256)
+
+/**
+ * \brief ECEF of one point, inlined into the vectorized loops
+ */
+static NMEA_INLINE void _nmea_geodetic2ecef(
+        double lat, double lon, double h,
+        double *x, double *y, double *z
+        )
+{
+    double sin_lat, cos_lat, sin_lon, cos_lon, N;
+
+    nmea_vsincos(lat, &sin_lat, &cos_lat);
+    nmea_vsincos(lon, &sin_lon, &cos_lon);
+    N = NMEA_ECEF_A / sqrt(1 - NMEA_ECEF_E2 * sin_lat * sin_lat);
+
+    *x = (N + h) * cos_lat * cos_lon;
+    *y = (N + h) * cos_lat * sin_lon;
+    *z = (N * (1 - NMEA_ECEF_E2) + h) * sin_lat;
+}
+
+/**
+ * \brief Convert geodetic coordinates to ECEF
+ * sin/cos are the inline kernels of vmath.h, the loops vectorize.
+ */
+void nmea_geodetic2ecef(
+        const double *lat, const double *lon, const double *h, int count,
+        double *x, double *y, double *z
+        )
+{
+    int it;
+
+    if(h)
+    {
+        for(it = 0; it < count; ++it)
+            _nmea_geodetic2ecef(lat[it], lon[it], h[it], x + it, y + it, z + it);
+    }
+    else
+    {
+        for(it = 0; it < count; ++it)
+            _nmea_geodetic2ecef(lat[it], lon[it], 0, x + it, y + it, z + it);
+    }
+}
+
+/**
+ * \brief Convert ECEF to geodetic coordinates
+ * Closed form of Heikkinen, no iteration. Error is far below a
+ * millimetre from the Earth's surface to beyond GPS orbit.
+ */
+void nmea_ecef2geodetic(
+        const double *x, const double *y, const double *z, int count,
+        double *lat, double *lon, double *h
+        )
+{
+    const double a = NMEA_ECEF_A, b = NMEA_ECEF_B, e2 = NMEA_ECEF_E2;
+    const double ep2 = e2 / (1 - e2);
+    int it;
+
+    for(it = 0; it < count; ++it)
+    {
+        double p2, p, zz, F, G, c, s, k, P, Q, r0, t, U, V, z0;
+
+        zz = z[it] * z[it];
+        p2 = x[it] * x[it] + y[it] * y[it];
+        p = sqrt(p2);
+        F = 54 * b * b * zz;
+        G = p2 + (1 - e2) * zz - e2 * (a * a - b * b);
+        c = e2 * e2 * F * p2 / (G * G * G);
+        s = cbrt(1 + c + sqrt(c * c + 2 * c));
+        k = s + 1 + 1 / s;
+        P = F / (3 * k * k * G * G);
+        Q = sqrt(1 + 2 * e2 * e2 * P);
+        r0 = -(P * e2 * p) / (1 + Q) +
+            sqrt(a * a / 2 * (1 + 1 / Q) - P * (1 - e2) * zz / (Q * (1 + Q)) - P * p2 / 2);
+        t = p - e2 * r0;
+        U = sqrt(t * t + zz);
+        V = sqrt(t * t + (1 - e2) * zz);
+        z0 = b * b * z[it] / (a * V);
+
+        lat[it] = atan2(z[it] + ep2 * z0, p);
+        lon[it] = atan2(y[it], x[it]);
+        if(h)
+            h[it] = U * (1 - b * b / (a * V));
+    }
+}
+
+/**
+ * \brief Prepare local frame around a reference point
+ */
+void nmea_enu_init(
+        nmeaENUREF *ref,
+        double lat,         /**< Latitude of reference in radians */
+        double lon,         /**< Longitude of reference in radians */
+        double h            /**< Height of reference above ellipsoid in meters */
+        )
+{
+    double sin_lat = sin(lat), cos_lat = cos(lat);
+    double sin_lon = sin(lon), cos_lon = cos(lon);
+
+    NMEA_ASSERT(ref != 0);
+
+    ref->lat = lat;
+    ref->lon = lon;
+    ref->h = h;
+    nmea_geodetic2ecef(&lat, &lon, &h, 1, &ref->x, &ref->y, &ref->z);
+
+    ref->rot[0][0] = -sin_lon;
+    ref->rot[0][1] = cos_lon;
+    ref->rot[0][2] = 0;
+    ref->rot[1][0] = -sin_lat * cos_lon;
+    ref->rot[1][1] = -sin_lat * sin_lon;
+    ref->rot[1][2] = cos_lat;
+    ref->rot[2][0] = cos_lat * cos_lon;
+    ref->rot[2][1] = cos_lat * sin_lon;
+    ref->rot[2][2] = sin_lat;
+}
+
+/**
+ * \brief Convert ECEF to local frame
+ */
+void nmea_ecef2enu(
+        const nmeaENUREF *ref,
+        const double *x, const double *y, const double *z, int count,
+        double *e, double *n, double *u
+        )
+{
+    const double r00 = ref->rot[0][0], r01 = ref->rot[0][1];
+    const double r10 = ref->rot[1][0], r11 = ref->rot[1][1], r12 = ref->rot[1][2];
+    const double r20 = ref->rot[2][0], r21 = ref->rot[2][1], r22 = ref->rot[2][2];
+    const double rx = ref->x, ry = ref->y, rz = ref->z;
+    int it;
+
+    for(it = 0; it < count; ++it)
+    {
+        double dx = x[it] - rx, dy = y[it] - ry, dz = z[it] - rz;
+
+        e[it] = r00 * dx + r01 * dy;
+        n[it] = r10 * dx + r11 * dy + r12 * dz;
+        u[it] = r20 * dx + r21 * dy + r22 * dz;
+    }
+}
+
+/**
+ * \brief Convert local frame to ECEF
+ */
+void nmea_enu2ecef(
+        const nmeaENUREF *ref,
+        const double *e, const double *n, const double *u, int count,
+        double *x, double *y, double *z
+        )
+{
+    const double r00 = ref->rot[0][0], r01 = ref->rot[0][1];
+    const double r10 = ref->rot[1][0], r11 = ref->rot[1][1], r12 = ref->rot[1][2];
+    const double r20 = ref->rot[2][0], r21 = ref->rot[2][1], r22 = ref->rot[2][2];
+    const double rx = ref->x, ry = ref->y, rz = ref->z;
+    int it;
+
+    for(it = 0; it < count; ++it)
+    {
+        x[it] = rx + r00 * e[it] + r10 * n[it] + r20 * u[it];
+        y[it] = ry + r01 * e[it] + r11 * n[it] + r21 * u[it];
+        z[it] = rz + r12 * n[it] + r22 * u[it];
+    }
+}
+
+/**
+ * \brief Convert geodetic coordinates to local frame
+ */
+void nmea_geodetic2enu(
+        const nmeaENUREF *ref,
+        const double *lat, const double *lon, const double *h, int count,
+        double *e, double *n, double *u
+        )
+{
+    double x[NMEA_ECEF_BLOCK], y[NMEA_ECEF_BLOCK], z[NMEA_ECEF_BLOCK];
+    int first, num;
+
+    for(first = 0; first < count; first += num)
+    {
+        num = count - first;
+        if(num > NMEA_ECEF_BLOCK)
+            num = NMEA_ECEF_BLOCK;
+
+        nmea_geodetic2ecef(lat + first, lon + first, h ? h + first : 0, num, x, y, z);
+        nmea_ecef2enu(ref, x, y, z, num, e + first, n + first, u + first);
+    }
+}
+
+/**
+ * \brief Convert local frame to geodetic coordinates
+ */
+void nmea_enu2geodetic(
+        const nmeaENUREF *ref,
+        const double *e, const double *n, const double *u, int count,
+        double *lat, double *lon, double *h
+        )
+{
+    double x[NMEA_ECEF_BLOCK], y[NMEA_ECEF_BLOCK], z[NMEA_ECEF_BLOCK];
+    int first, num;
+
+    for(first = 0; first < count; first += num)
+    {
+        num = count - first;
+        if(num > NMEA_ECEF_BLOCK)
+            num = NMEA_ECEF_BLOCK;
+
+        nmea_enu2ecef(ref, e + first, n + first, u + first, num, x, y, z);
+        nmea_ecef2geodetic(x, y, z, num, lat + first, lon + first, h ? h + first : 0);
+    }
+}
@@ -19,58 +19,221 @@
 
 int nmea_gen_GPGGA(char *buff, int buff_sz, nmeaGPGGA *pack)
 {
-    return nmea_printf(buff, buff_sz,
-        "$GPGGA,%02d%02d%02d.%02d,%07.4f,%C,%07.4f,%C,%1d,%02d,%03.1f,%03.1f,%C,%03.1f,%C,%03.1f,%04d",
-        pack->utc.hour, pack->utc.min, pack->utc.sec, pack->utc.hsec,
-        pack->lat, pack->ns, pack->lon, pack->ew,
-        pack->sig, pack->satinuse, pack->HDOP, pack->elv, pack->elv_units,
-        pack->diff, pack->diff_units, pack->dgps_age, pack->dgps_sid);
+    nmeaFMT fmt;
+    int retval;
+
+    nmea_fmt_begin(&fmt, buff, buff_sz, "GPGGA");
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->utc.hour, 2);
+    nmea_fmt_int(&fmt, pack->utc.min, 2);
+    nmea_fmt_int(&fmt, pack->utc.sec, 2);
+    nmea_fmt_char(&fmt, '.');
+    nmea_fmt_int(&fmt, pack->utc.hsec, 2);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->lat, 7, 4);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->ns);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->lon, 7, 4);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->ew);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->sig, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->satinuse, 2);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->HDOP, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->elv, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->elv_units);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->diff, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->diff_units);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->dgps_age, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->dgps_sid, 4);
+
+    if(0 > (retval = nmea_fmt_end(&fmt)))
+    {
+        retval = nmea_printf(buff, buff_sz,
+            "$GPGGA,%02d%02d%02d.%02d,%07.4f,%C,%07.4f,%C,%1d,%02d,%03.1f,%03.1f,%C,%03.1f,%C,%03.1f,%04d",
+            pack->utc.hour, pack->utc.min, pack->utc.sec, pack->utc.hsec,
+            pack->lat, pack->ns, pack->lon, pack->ew,
+            pack->sig, pack->satinuse, pack->HDOP, pack->elv, pack->elv_units,
+            pack->diff, pack->diff_units, pack->dgps_age, pack->dgps_sid);
+    }
+
+    return retval;
 }
 
 int nmea_gen_GPGSA(char *buff, int buff_sz, nmeaGPGSA *pack)
 {
-    return nmea_printf(buff, buff_sz,
-        "$GPGSA,%C,%1d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%03.1f,%03.1f,%03.1f",
-        pack->fix_mode, pack->fix_type,
-        pack->sat_prn[0], pack->sat_prn[1], pack->sat_prn[2], pack->sat_prn[3], pack->sat_prn[4], pack->sat_prn[5],
-        pack->sat_prn[6], pack->sat_prn[7], pack->sat_prn[8], pack->sat_prn[9], pack->sat_prn[10], pack->sat_prn[11],
-        pack->PDOP, pack->HDOP, pack->VDOP);
+    nmeaFMT fmt;
+    int it, retval;
+
+    nmea_fmt_begin(&fmt, buff, buff_sz, "GPGSA");
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->fix_mode);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->fix_type, 1);
+
+    for(it = 0; it < NMEA_MAXSAT; ++it)
+    {
+        nmea_fmt_char(&fmt, ',');
+        nmea_fmt_int(&fmt, pack->sat_prn[it], 2);
+    }
+
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->PDOP, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->HDOP, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->VDOP, 3, 1);
+
+    if(0 > (retval = nmea_fmt_end(&fmt)))
+    {
+        retval = nmea_printf(buff, buff_sz,
+            "$GPGSA,%C,%1d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%02d,%03.1f,%03.1f,%03.1f",
+            pack->fix_mode, pack->fix_type,
+            pack->sat_prn[0], pack->sat_prn[1], pack->sat_prn[2], pack->sat_prn[3], pack->sat_prn[4], pack->sat_prn[5],
+            pack->sat_prn[6], pack->sat_prn[7], pack->sat_prn[8], pack->sat_prn[9], pack->sat_prn[10], pack->sat_prn[11],
+            pack->PDOP, pack->HDOP, pack->VDOP);
+    }
+
+    return retval;
 }
 
 int nmea_gen_GPGSV(char *buff, int buff_sz, nmeaGPGSV *pack)
 {
-    return nmea_printf(buff, buff_sz,
-        "$GPGSV,%1d,%1d,%02d,"
-        "%02d,%02d,%03d,%02d,"
-        "%02d,%02d,%03d,%02d,"
-        "%02d,%02d,%03d,%02d,"
-        "%02d,%02d,%03d,%02d",
-        pack->pack_count, pack->pack_index + 1, pack->sat_count,
-        pack->sat_data[0].id, pack->sat_data[0].elv, pack->sat_data[0].azimuth, pack->sat_data[0].sig,
-        pack->sat_data[1].id, pack->sat_data[1].elv, pack->sat_data[1].azimuth, pack->sat_data[1].sig,
-        pack->sat_data[2].id, pack->sat_data[2].elv, pack->sat_data[2].azimuth, pack->sat_data[2].sig,
-        pack->sat_data[3].id, pack->sat_data[3].elv, pack->sat_data[3].azimuth, pack->sat_data[3].sig);
+    nmeaFMT fmt;
+    int it, retval;
+
+    nmea_fmt_begin(&fmt, buff, buff_sz, "GPGSV");
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->pack_count, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->pack_index + 1, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->sat_count, 2);
+
+    for(it = 0; it < NMEA_SATINPACK; ++it)
+    {
+        nmea_fmt_char(&fmt, ',');
+        nmea_fmt_int(&fmt, pack->sat_data[it].id, 2);
+        nmea_fmt_char(&fmt, ',');
+        nmea_fmt_int(&fmt, pack->sat_data[it].elv, 2);
+        nmea_fmt_char(&fmt, ',');
+        nmea_fmt_int(&fmt, pack->sat_data[it].azimuth, 3);
+        nmea_fmt_char(&fmt, ',');
+        nmea_fmt_int(&fmt, pack->sat_data[it].sig, 2);
+    }
+
+    if(0 > (retval = nmea_fmt_end(&fmt)))
+    {
+        retval = nmea_printf(buff, buff_sz,
+            "$GPGSV,%1d,%1d,%02d,"
+            "%02d,%02d,%03d,%02d,"
+            "%02d,%02d,%03d,%02d,"
+            "%02d,%02d,%03d,%02d,"
+            "%02d,%02d,%03d,%02d",
+            pack->pack_count, pack->pack_index + 1, pack->sat_count,
+            pack->sat_data[0].id, pack->sat_data[0].elv, pack->sat_data[0].azimuth, pack->sat_data[0].sig,
+            pack->sat_data[1].id, pack->sat_data[1].elv, pack->sat_data[1].azimuth, pack->sat_data[1].sig,
+            pack->sat_data[2].id, pack->sat_data[2].elv, pack->sat_data[2].azimuth, pack->sat_data[2].sig,
+            pack->sat_data[3].id, pack->sat_data[3].elv, pack->sat_data[3].azimuth, pack->sat_data[3].sig);
+    }
+
+    return retval;
 }
 
 int nmea_gen_GPRMC(char *buff, int buff_sz, nmeaGPRMC *pack)
 {
-    return nmea_printf(buff, buff_sz,
-        "$GPRMC,%02d%02d%02d.%02d,%C,%07.4f,%C,%07.4f,%C,%03.1f,%03.1f,%02d%02d%02d,%03.1f,%C,%C",
-        pack->utc.hour, pack->utc.min, pack->utc.sec, pack->utc.hsec,
-        pack->status, pack->lat, pack->ns, pack->lon, pack->ew,
-        pack->speed, pack->direction,
-        pack->utc.day, pack->utc.mon + 1, pack->utc.year - 100,
-        pack->declination, pack->declin_ew, pack->mode);
+    nmeaFMT fmt;
+    int retval;
+
+    nmea_fmt_begin(&fmt, buff, buff_sz, "GPRMC");
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->utc.hour, 2);
+    nmea_fmt_int(&fmt, pack->utc.min, 2);
+    nmea_fmt_int(&fmt, pack->utc.sec, 2);
+    nmea_fmt_char(&fmt, '.');
+    nmea_fmt_int(&fmt, pack->utc.hsec, 2);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->status);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->lat, 7, 4);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->ns);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->lon, 7, 4);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->ew);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->speed, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->direction, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_int(&fmt, pack->utc.day, 2);
+    nmea_fmt_int(&fmt, pack->utc.mon + 1, 2);
+    nmea_fmt_int(&fmt, pack->utc.year - 100, 2);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->declination, 3, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->declin_ew);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->mode);
+
+    if(0 > (retval = nmea_fmt_end(&fmt)))
+    {
+        retval = nmea_printf(buff, buff_sz,
+            "$GPRMC,%02d%02d%02d.%02d,%C,%07.4f,%C,%07.4f,%C,%03.1f,%03.1f,%02d%02d%02d,%03.1f,%C,%C",
+            pack->utc.hour, pack->utc.min, pack->utc.sec, pack->utc.hsec,
+            pack->status, pack->lat, pack->ns, pack->lon, pack->ew,
+            pack->speed, pack->direction,
+            pack->utc.day, pack->utc.mon + 1, pack->utc.year - 100,
+            pack->declination, pack->declin_ew, pack->mode);
+    }
+
+    return retval;
 }
 
 int nmea_gen_GPVTG(char *buff, int buff_sz, nmeaGPVTG *pack)
 {
-    return nmea_printf(buff, buff_sz,
-        "$GPVTG,%.1f,%C,%.1f,%C,%.1f,%C,%.1f,%C",
-        pack->dir, pack->dir_t,
-        pack->dec, pack->dec_m,
-        pack->spn, pack->spn_n,
-        pack->spk, pack->spk_k);
+    nmeaFMT fmt;
+    int retval;
+
+    nmea_fmt_begin(&fmt, buff, buff_sz, "GPVTG");
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->dir, 0, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->dir_t);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->dec, 0, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->dec_m);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->spn, 0, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->spn_n);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_fixed(&fmt, pack->spk, 0, 1);
+    nmea_fmt_char(&fmt, ',');
+    nmea_fmt_char(&fmt, pack->spk_k);
+
+    if(0 > (retval = nmea_fmt_end(&fmt)))
+    {
+        retval = nmea_printf(buff, buff_sz,
+            "$GPVTG,%.1f,%C,%.1f,%C,%.1f,%C,%.1f,%C",
+            pack->dir, pack->dir_t,
+            pack->dec, pack->dec_m,
+            pack->spn, pack->spn_n,
+            pack->spk, pack->spk_k);
+    }
+
+    return retval;
 }
 
 void nmea_info2GPGGA(const nmeaINFO *info, nmeaGPGGA *pack)
@@ -20,14 +20,79 @@
 # pragma warning(disable: 4100) /* unreferenced formal parameter */
 #endif
 
+/* random source of generators running in this thread */
+static NMEA_TLS nmeaRANDOM *nmea_random_src = 0;
+
+/**
+ * \brief Random value in [min, max]
+ * Uses the random state bound to the calling thread by nmea_random_bind,
+ * or the global rand() when nothing is bound.
+ */
 double nmea_random(double min, double max)
 {
     static double rand_max = RAND_MAX;
-    double rand_val = rand();
+    double rand_val;
     double bounds = max - min;
+
+    if(nmea_random_src)
+        return nmea_random_r(nmea_random_src, min, max);
+
+    rand_val = rand();
     return min + (rand_val * bounds) / rand_max;
 }
 
+static unsigned int nmea_random_rotl(unsigned int x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+/**
+ * \brief Initialize random state from 32-bit seed
+ */
+void nmea_random_seed(nmeaRANDOM *rnd, unsigned int seed)
+{
+    unsigned int z;
+    int it;
+
+    for(it = 0; it < 4; ++it)
+    {
+        z = (seed += 0x9E3779B9U);
+        z = (z ^ (z >> 16)) * 0x85EBCA6BU;
+        z = (z ^ (z >> 13)) * 0xC2B2AE35U;
+        rnd->s[it] = z ^ (z >> 16);
+    }
+}
+
+/**
+ * \brief Random value in [min, max] from own random state
+ */
+double nmea_random_r(nmeaRANDOM *rnd, double min, double max)
+{
+    unsigned int *s = rnd->s;
+    unsigned int res = nmea_random_rotl(s[1] * 5, 7) * 9;
+    unsigned int t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = nmea_random_rotl(s[3], 11);
+
+    return min + (res * (max - min)) / 4294967295.0;
+}
+
+/**
+ * \brief Bind random state to generators running in calling thread
+ * \return Previously bound state (0 means global rand())
+ */
+nmeaRANDOM * nmea_random_bind(nmeaRANDOM *rnd)
+{
+    nmeaRANDOM *prev = nmea_random_src;
+    nmea_random_src = rnd;
+    return prev;
+}
+
 /*
  * low level
  */
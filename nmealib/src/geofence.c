@@ -0,0 +1,468 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file geofence.h */
+
+#include "nmea/geofence.h"
+#include "nmea/gmath.h"
+#include "nmea/context.h"
+
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NMEA_FENCE_R    ((double)NMEA_EARTHRADIUS_M)
+
+typedef struct _nmeaFENCEPAIR
+{
+    int     lat;
+    int     lon;
+    int     fence;
+
+} nmeaFENCEPAIR;
+
+/**
+ * \brief Longitude radians per meter at the worst latitude of a box
+ */
+static double nmea_fence_lon_per_m(double min_lat, double max_lat)
+{
+    double lat = (fabs(min_lat) > fabs(max_lat)) ? fabs(min_lat) : fabs(max_lat);
+    double c = cos(lat);
+
+    if(c < 0.01)
+        c = 0.01;
+
+    return 1 / (NMEA_FENCE_R * c);
+}
+
+static nmeaFENCE * nmea_fence_new(nmeaGEOFENCE *gf)
+{
+    nmeaFENCE *fence;
+
+    if(gf->fence_count == gf->fence_size)
+    {
+        int size = gf->fence_size ? 2 * gf->fence_size : 64;
+        fence = realloc(gf->fence, size * sizeof(nmeaFENCE));
+        if(!fence)
+        {
+            nmea_error("Insufficient memory!");
+            return 0;
+        }
+        gf->fence = fence;
+        gf->fence_size = size;
+    }
+
+    fence = gf->fence + gf->fence_count;
+    memset(fence, 0, sizeof(nmeaFENCE));
+
+    return fence;
+}
+
+/**
+ * \brief Prepare empty engine
+ * @return true (1) - success or false (0) - fail
+ */
+int nmea_geofence_init(
+        nmeaGEOFENCE *gf,
+        double margin,      /**< Hysteresis in meters */
+        double cell         /**< Grid cell in radians, 0 - NMEA_GEOFENCE_CELL */
+        )
+{
+    NMEA_ASSERT(gf);
+
+    memset(gf, 0, sizeof(nmeaGEOFENCE));
+    gf->margin = (margin > 0) ? margin : 0;
+    gf->cell = (cell > 0) ? cell : NMEA_GEOFENCE_CELL;
+
+    return 1;
+}
+
+/**
+ * \brief Free memory of engine
+ */
+void nmea_geofence_destroy(nmeaGEOFENCE *gf)
+{
+    free(gf->fence);
+    free(gf->vx);
+    free(gf->vy);
+    free(gf->cells);
+    free(gf->cell_fence);
+    memset(gf, 0, sizeof(nmeaGEOFENCE));
+}
+
+/**
+ * \brief Add circle fence
+ * @return true (1) - success or false (0) - fail
+ */
+int nmea_geofence_add_circle(
+        nmeaGEOFENCE *gf,
+        int id,                 /**< Id reported in events */
+        const nmeaPOS *center,  /**< Center in radians */
+        double radius           /**< Radius in meters */
+        )
+{
+    nmeaFENCE *fence = nmea_fence_new(gf);
+    double dlat = radius / NMEA_FENCE_R, dlon;
+
+    if(!fence)
+        return 0;
+
+    fence->type = NMEA_FENCE_CIRCLE;
+    fence->id = id;
+    fence->origin = *center;
+    fence->radius = radius;
+    fence->min_pos.lat = center->lat - dlat;
+    fence->max_pos.lat = center->lat + dlat;
+    dlon = radius * nmea_fence_lon_per_m(fence->min_pos.lat, fence->max_pos.lat);
+    fence->min_pos.lon = center->lon - dlon;
+    fence->max_pos.lon = center->lon + dlon;
+
+    gf->fence_count++;
+
+    return 1;
+}
+
+/**
+ * \brief Add polygon fence
+ * Vertices are projected to a plane around the center of the bounding
+ * box, so fences should be small against the Earth (up to some tens of
+ * km) and not cross the 180th meridian.
+ * @return true (1) - success or false (0) - fail
+ */
+int nmea_geofence_add_polygon(
+        nmeaGEOFENCE *gf,
+        int id,                 /**< Id reported in events */
+        const nmeaPOS *vertex,  /**< Vertices in radians, not closed */
+        int count               /**< Number of vertices, at least 3 */
+        )
+{
+    nmeaFENCE *fence;
+    int it;
+
+    if(count < 3 || !(fence = nmea_fence_new(gf)))
+        return 0;
+
+    if(gf->vertex_count + count > gf->vertex_size)
+    {
+        int size = gf->vertex_size ? 2 * gf->vertex_size : 1024;
+        double *vx, *vy;
+
+        while(size < gf->vertex_count + count)
+            size *= 2;
+
+        vx = realloc(gf->vx, size * sizeof(double));
+        if(vx)
+            gf->vx = vx;
+        vy = realloc(gf->vy, size * sizeof(double));
+        if(vy)
+            gf->vy = vy;
+
+        if(!vx || !vy)
+        {
+            nmea_error("Insufficient memory!");
+            return 0;
+        }
+        gf->vertex_size = size;
+    }
+
+    fence->type = NMEA_FENCE_POLYGON;
+    fence->id = id;
+    fence->first = gf->vertex_count;
+    fence->count = count;
+    fence->min_pos = fence->max_pos = vertex[0];
+
+    for(it = 1; it < count; ++it)
+    {
+        if(vertex[it].lat < fence->min_pos.lat) fence->min_pos.lat = vertex[it].lat;
+        if(vertex[it].lon < fence->min_pos.lon) fence->min_pos.lon = vertex[it].lon;
+        if(vertex[it].lat > fence->max_pos.lat) fence->max_pos.lat = vertex[it].lat;
+        if(vertex[it].lon > fence->max_pos.lon) fence->max_pos.lon = vertex[it].lon;
+    }
+
+    fence->origin.lat = (fence->min_pos.lat + fence->max_pos.lat) / 2;
+    fence->origin.lon = (fence->min_pos.lon + fence->max_pos.lon) / 2;
+    fence->scale = NMEA_FENCE_R * cos(fence->origin.lat);
+
+    for(it = 0; it < count; ++it)
+    {
+        gf->vx[fence->first + it] = (vertex[it].lon - fence->origin.lon) * fence->scale;
+        gf->vy[fence->first + it] = (vertex[it].lat - fence->origin.lat) * NMEA_FENCE_R;
+    }
+
+    gf->vertex_count += count;
+    gf->fence_count++;
+
+    return 1;
+}
+
+static int nmea_fence_pair_cmp(const void *a, const void *b)
+{
+    const nmeaFENCEPAIR *pa = a, *pb = b;
+
+    if(pa->lat != pb->lat)
+        return (pa->lat < pb->lat) ? -1 : 1;
+    if(pa->lon != pb->lon)
+        return (pa->lon < pb->lon) ? -1 : 1;
+    return pa->fence - pb->fence;
+}
+
+/**
+ * \brief Cells of a fence bounding box grown by the margin
+ */
+static void nmea_fence_cells(const nmeaGEOFENCE *gf, const nmeaFENCE *fence, int *cell)
+{
+    double dlat = gf->margin / NMEA_FENCE_R;
+    double dlon = gf->margin * nmea_fence_lon_per_m(fence->min_pos.lat, fence->max_pos.lat);
+
+    cell[0] = (int)floor((fence->min_pos.lat - dlat) / gf->cell);
+    cell[1] = (int)floor((fence->min_pos.lon - dlon) / gf->cell);
+    cell[2] = (int)floor((fence->max_pos.lat + dlat) / gf->cell);
+    cell[3] = (int)floor((fence->max_pos.lon + dlon) / gf->cell);
+}
+
+/**
+ * \brief Make grid index of the fences added so far
+ * Every fence is listed in the cells its bounding box, grown by the
+ * margin, touches. Choose the cell size near the size of typical fences.
+ * @return true (1) - success or false (0) - fail
+ */
+int nmea_geofence_build(nmeaGEOFENCE *gf)
+{
+    nmeaFENCEPAIR *pair;
+    int cell[4], it, lat, lon, npair = 0, ncell = 0;
+
+    free(gf->cells);
+    free(gf->cell_fence);
+    gf->cells = 0;
+    gf->cell_fence = 0;
+    gf->cell_count = 0;
+
+    for(it = 0; it < gf->fence_count; ++it)
+    {
+        nmea_fence_cells(gf, gf->fence + it, cell);
+        npair += (cell[2] - cell[0] + 1) * (cell[3] - cell[1] + 1);
+    }
+
+    pair = malloc((npair + 1) * sizeof(nmeaFENCEPAIR));
+    gf->cell_fence = malloc((npair + 1) * sizeof(int));
+    gf->cells = malloc((npair + 1) * sizeof(nmeaFENCECELL));
+
+    if(!pair || !gf->cell_fence || !gf->cells)
+    {
+        free(pair);
+        free(gf->cells);
+        free(gf->cell_fence);
+        gf->cells = 0;
+        gf->cell_fence = 0;
+        nmea_error("Insufficient memory!");
+        return 0;
+    }
+
+    npair = 0;
+    for(it = 0; it < gf->fence_count; ++it)
+    {
+        nmea_fence_cells(gf, gf->fence + it, cell);
+        for(lat = cell[0]; lat <= cell[2]; ++lat)
+        {
+            for(lon = cell[1]; lon <= cell[3]; ++lon)
+            {
+                pair[npair].lat = lat;
+                pair[npair].lon = lon;
+                pair[npair].fence = it;
+                npair++;
+            }
+        }
+    }
+
+    qsort(pair, npair, sizeof(nmeaFENCEPAIR), &nmea_fence_pair_cmp);
+
+    for(it = 0; it < npair; ++it)
+    {
+        if(!ncell || pair[it].lat != gf->cells[ncell - 1].lat || pair[it].lon != gf->cells[ncell - 1].lon)
+        {
+            gf->cells[ncell].lat = pair[it].lat;
+            gf->cells[ncell].lon = pair[it].lon;
+            gf->cells[ncell].first = it;
+            ncell++;
+        }
+        gf->cell_fence[it] = pair[it].fence;
+    }
+
+    gf->cells[ncell].first = npair;
+    gf->cell_count = ncell;
+
+    free(pair);
+
+    return 1;
+}
+
+/**
+ * \brief Signed distance from the fence border in meters, positive inside
+ */
+static double nmea_fence_dist(const nmeaGEOFENCE *gf, const nmeaFENCE *fence, const nmeaPOS *pos)
+{
+    const double *vx = gf->vx + fence->first, *vy = gf->vy + fence->first;
+    double px, py, sx, sy, qx, qy, len2, t, d2, min_d2 = DBL_MAX;
+    int i, j, inside = 0;
+
+    if(NMEA_FENCE_CIRCLE == fence->type)
+    {
+        double sin_dlat = sin((pos->lat - fence->origin.lat) / 2);
+        double sin_dlon = sin((pos->lon - fence->origin.lon) / 2);
+        double h = sin_dlat * sin_dlat +
+            cos(pos->lat) * cos(fence->origin.lat) * sin_dlon * sin_dlon;
+        return fence->radius - 2 * NMEA_FENCE_R * asin(sqrt((h < 1) ? h : 1));
+    }
+
+    px = (pos->lon - fence->origin.lon) * fence->scale;
+    py = (pos->lat - fence->origin.lat) * NMEA_FENCE_R;
+
+    for(i = 0, j = fence->count - 1; i < fence->count; j = i++)
+    {
+        if((vy[i] > py) != (vy[j] > py) &&
+            px < (vx[j] - vx[i]) * (py - vy[i]) / (vy[j] - vy[i]) + vx[i])
+            inside = !inside;
+
+        sx = vx[j] - vx[i];
+        sy = vy[j] - vy[i];
+        qx = px - vx[i];
+        qy = py - vy[i];
+        len2 = sx * sx + sy * sy;
+        t = (len2 > 0) ? (qx * sx + qy * sy) / len2 : 0;
+        t = (t < 0) ? 0 : ((t > 1) ? 1 : t);
+        qx -= t * sx;
+        qy -= t * sy;
+        d2 = qx * qx + qy * qy;
+        if(d2 < min_d2)
+            min_d2 = d2;
+    }
+
+    return inside ? sqrt(min_d2) : -sqrt(min_d2);
+}
+
+/**
+ * \brief Prepare state of a subject outside of every fence
+ */
+void nmea_fencestate_init(nmeaFENCESTATE *st)
+{
+    memset(st, 0, sizeof(nmeaFENCESTATE));
+}
+
+/**
+ * \brief Free memory of subject state
+ */
+void nmea_fencestate_destroy(nmeaFENCESTATE *st)
+{
+    free(st->inside);
+    memset(st, 0, sizeof(nmeaFENCESTATE));
+}
+
+/**
+ * \brief Test a fix of one subject against all fences
+ * Only the fences of the grid cell of the fix are tested (binary search
+ * for the cell), plus the fences the subject is inside. A subject enters
+ * a fence when it is more than margin inside and exits when it is more
+ * than margin outside. Events which do not fit in ev are reported by
+ * the next call.
+ * @return Number of events in ev
+ */
+int nmea_geofence_check(
+        const nmeaGEOFENCE *gf,
+        nmeaFENCESTATE *st,
+        const nmeaPOS *pos,     /**< Fix in radians */
+        nmeaFENCEEVENT *ev,     /**< (O) Events */
+        int max_ev              /**< Size of ev */
+        )
+{
+    const int *cand = 0;
+    int ncand = 0, lat, lon, lo, hi, mid, ic, is, f, in, nin, nev = 0;
+    double d;
+
+    lat = (int)floor(pos->lat / gf->cell);
+    lon = (int)floor(pos->lon / gf->cell);
+    lo = 0;
+    hi = gf->cell_count - 1;
+
+    while(lo <= hi)
+    {
+        const nmeaFENCECELL *c;
+        mid = lo + (hi - lo) / 2;
+        c = gf->cells + mid;
+        if(c->lat == lat && c->lon == lon)
+        {
+            cand = gf->cell_fence + c->first;
+            ncand = c[1].first - c->first;
+            break;
+        }
+        if(c->lat < lat || (c->lat == lat && c->lon < lon))
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    if(st->count + ncand > st->size / 2)
+    {
+        int size = 2 * (st->count + ncand) + 16;
+        int *inside = realloc(st->inside, size * sizeof(int));
+        if(!inside)
+        {
+            nmea_error("Insufficient memory!");
+            return 0;
+        }
+        st->inside = inside;
+        st->size = size;
+    }
+
+    /* merge fences the subject is inside with candidates, new list after the old */
+    nin = st->count;
+    for(is = 0, ic = 0; is < st->count || ic < ncand; )
+    {
+        if(ic == ncand || (is < st->count && st->inside[is] < cand[ic]))
+        {
+            /* no longer in a cell of the fence, rare, so the distance is worth it */
+            f = st->inside[is++];
+            in = 1;
+            d = nmea_fence_dist(gf, gf->fence + f, pos);
+        }
+        else
+        {
+            f = cand[ic++];
+            in = (is < st->count && st->inside[is] == f);
+            if(in)
+                is++;
+            d = nmea_fence_dist(gf, gf->fence + f, pos);
+        }
+
+        if(nev < max_ev && in && d < -gf->margin)
+        {
+            ev[nev].id = gf->fence[f].id;
+            ev[nev].type = NMEA_FENCE_EXIT;
+            ev[nev].dist = d;
+            nev++;
+            in = 0;
+        }
+        else if(nev < max_ev && !in && d > gf->margin)
+        {
+            ev[nev].id = gf->fence[f].id;
+            ev[nev].type = NMEA_FENCE_ENTER;
+            ev[nev].dist = d;
+            nev++;
+            in = 1;
+        }
+
+        if(in)
+            st->inside[nin++] = f;
+    }
+
+    memmove(st->inside, st->inside + st->count, (nin - st->count) * sizeof(int));
+    st->count = nin - st->count;
+
+    return nev;
+}
@@ -11,73 +11,135 @@
 /*! \file gmath.h */
 
 #include "nmea/gmath.h"
+#include "vmath.h"
 
 #include <math.h>
 #include <float.h>
+#include <stddef.h>
+
+#define NMEA_ARRAY_BLOCK    (256)   /**< Points converted per pass of the array functions */
 
 /**
  * \fn nmea_degree2radian
  * \brief Convert degree to radian
  */
 double nmea_degree2radian(double val)
-{ return (val * NMEA_PI180); }
+{ return nmea_inl_degree2radian(val); }
 
 /**
  * \fn nmea_radian2degree
  * \brief Convert radian to degree
  */
 double nmea_radian2degree(double val)
-{ return (val / NMEA_PI180); }
+{ return nmea_inl_radian2degree(val); }
 
 /**
  * \brief Convert NDEG (NMEA degree) to fractional degree
  */
 double nmea_ndeg2degree(double val)
-{
-    double deg = ((int)(val / 100));
-    val = deg + (val - deg * 100) / 60;
-    return val;
-}
+{ return nmea_inl_ndeg2degree(val); }
 
 /**
  * \brief Convert fractional degree to NDEG (NMEA degree)
  */
 double nmea_degree2ndeg(double val)
-{
-    double int_part;
-    double fra_part;
-    fra_part = modf(val, &int_part);
-    val = int_part * 100 + fra_part * 60;
-    return val;
-}
+{ return nmea_inl_degree2ndeg(val); }
 
 /**
  * \fn nmea_ndeg2radian
  * \brief Convert NDEG (NMEA degree) to radian
  */
 double nmea_ndeg2radian(double val)
-{ return nmea_degree2radian(nmea_ndeg2degree(val)); }
+{ return nmea_inl_ndeg2radian(val); }
 
 /**
  * \fn nmea_radian2ndeg
  * \brief Convert radian to NDEG (NMEA degree)
  */
 double nmea_radian2ndeg(double val)
-{ return nmea_degree2ndeg(nmea_radian2degree(val)); }
+{ return nmea_inl_radian2ndeg(val); }
 
 /**
  * \brief Calculate PDOP (Position Dilution Of Precision) factor
  */
 double nmea_calc_pdop(double hdop, double vdop)
-{
-    return sqrt(pow(hdop, 2) + pow(vdop, 2));
-}
+{ return nmea_inl_calc_pdop(hdop, vdop); }
 
 double nmea_dop2meters(double dop)
-{ return (dop * NMEA_DOP_FACTOR); }
+{ return nmea_inl_dop2meters(dop); }
 
 double nmea_meters2dop(double meters)
-{ return (meters / NMEA_DOP_FACTOR); }
+{ return nmea_inl_meters2dop(meters); }
+
+/**
+ * \brief Convert array of degrees to radians
+ */
+void nmea_degree2radian_array(const double *val, double *res, int count)
+{
+    int it;
+    for(it = 0; it < count; ++it)
+        res[it] = nmea_inl_degree2radian(val[it]);
+}
+
+/**
+ * \brief Convert array of radians to degrees
+ */
+void nmea_radian2degree_array(const double *val, double *res, int count)
+{
+    int it;
+    for(it = 0; it < count; ++it)
+        res[it] = nmea_inl_radian2degree(val[it]);
+}
+
+/**
+ * \brief Convert array of NDEG (NMEA degree) to fractional degrees
+ */
+void nmea_ndeg2degree_array(const double *val, double *res, int count)
+{
+    int it;
+    for(it = 0; it < count; ++it)
+        res[it] = nmea_inl_ndeg2degree(val[it]);
+}
+
+/**
+ * \brief Convert array of fractional degrees to NDEG (NMEA degree)
+ */
+void nmea_degree2ndeg_array(const double *val, double *res, int count)
+{
+    int it;
+    for(it = 0; it < count; ++it)
+        res[it] = nmea_inl_degree2ndeg(val[it]);
+}
+
+/**
+ * \brief Convert array of NDEG (NMEA degree) to radians
+ */
+void nmea_ndeg2radian_array(const double *val, double *res, int count)
+{
+    int it;
+    for(it = 0; it < count; ++it)
+        res[it] = nmea_inl_ndeg2radian(val[it]);
+}
+
+/**
+ * \brief Convert array of radians to NDEG (NMEA degree)
+ */
+void nmea_radian2ndeg_array(const double *val, double *res, int count)
+{
+    int it;
+    for(it = 0; it < count; ++it)
+        res[it] = nmea_inl_radian2ndeg(val[it]);
+}
+
+/**
+ * \brief Calculate PDOP of arrays of HDOP and VDOP
+ */
+void nmea_calc_pdop_array(const double *hdop, const double *vdop, double *pdop, int count)
+{
+    int it;
+    for(it = 0; it < count; ++it)
+        pdop[it] = nmea_inl_calc_pdop(hdop[it], vdop[it]);
+}
 
 /**
  * \brief Calculate distance between two points
@@ -375,3 +437,449 @@ void nmea_pos2info(const nmeaPOS *pos, nmeaINFO *info)
     info->lat = nmea_radian2ndeg(pos->lat);
     info->lon = nmea_radian2ndeg(pos->lon);
 }
+
+/**
+ * \brief Unit vectors of positions on the sphere
+ */
+static void _nmea_unit_vectors(
+        const double *lat, const double *lon, int count,
+        double *x, double *y, double *z
+        )
+{
+    int it;
+
+    for(it = 0; it < count; ++it)
+    {
+        double sin_lat, cos_lat, sin_lon, cos_lon;
+        nmea_vsincos(lat[it], &sin_lat, &cos_lat);
+        nmea_vsincos(lon[it], &sin_lon, &cos_lon);
+        x[it] = cos_lat * cos_lon;
+        y[it] = cos_lat * sin_lon;
+        z[it] = sin_lat;
+    }
+}
+
+/**
+ * \brief Great circle distance from the chord between two unit vectors
+ */
+static NMEA_INLINE double _nmea_chord_distance(double dx, double dy, double dz)
+{
+    return ((double)NMEA_EARTHRADIUS_M) * 2 *
+        nmea_vasin(0.5 * sqrt(dx * dx + dy * dy + dz * dz));
+}
+
+/**
+ * \brief Distances between consecutive points of a track
+ * Same sphere as nmea_distance but computed from the chord, which stays
+ * accurate for short legs where acos of the law of cosines loses up to
+ * decimetres. Differs from exact spherical distance by less than 1e-8 m
+ * plus 1e-12 relative per leg, the relative part only near antipodes.
+ * Arrays are processed in blocks on the stack, nothing is allocated.
+ * \return Length of track in meters
+ */
+double nmea_distance_track(
+        const double *lat,      /**< Latitudes in radians */
+        const double *lon,      /**< Longitudes in radians */
+        int count,              /**< Number of points */
+        double *dist            /**< Distances in meters, count - 1 elements (may be NULL) */
+        )
+{
+    double x[NMEA_ARRAY_BLOCK + 1], y[NMEA_ARRAY_BLOCK + 1], z[NMEA_ARRAY_BLOCK + 1];
+    double leg[NMEA_ARRAY_BLOCK];
+    double total = 0, *out;
+    int first, num, it;
+
+    for(first = 0; first + 1 < count; first += num)
+    {
+        num = count - 1 - first;
+        if(num > NMEA_ARRAY_BLOCK)
+            num = NMEA_ARRAY_BLOCK;
+
+        out = dist ? dist + first : leg;
+
+        _nmea_unit_vectors(lat + first, lon + first, num + 1, x, y, z);
+
+        for(it = 0; it < num; ++it)
+            out[it] = _nmea_chord_distance(
+                x[it + 1] - x[it], y[it + 1] - y[it], z[it + 1] - z[it]);
+
+        for(it = 0; it < num; ++it)
+            total += out[it];
+    }
+
+    return total;
+}
+
+/**
+ * \brief Distances from one position to many
+ * Accuracy as nmea_distance_track.
+ */
+void nmea_distance_one2many(
+        const nmeaPOS *from_pos,    /**< From position in radians */
+        const double *lat,          /**< Latitudes in radians */
+        const double *lon,          /**< Longitudes in radians */
+        int count,                  /**< Number of positions */
+        double *dist                /**< Distances in meters, count elements */
+        )
+{
+    double x[NMEA_ARRAY_BLOCK], y[NMEA_ARRAY_BLOCK], z[NMEA_ARRAY_BLOCK];
+    double fx, fy, fz;
+    int first, num, it;
+
+    _nmea_unit_vectors(&from_pos->lat, &from_pos->lon, 1, &fx, &fy, &fz);
+
+    for(first = 0; first < count; first += num)
+    {
+        num = count - first;
+        if(num > NMEA_ARRAY_BLOCK)
+            num = NMEA_ARRAY_BLOCK;
+
+        _nmea_unit_vectors(lat + first, lon + first, num, x, y, z);
+
+        for(it = 0; it < num; ++it)
+            dist[first + it] = _nmea_chord_distance(x[it] - fx, y[it] - fy, z[it] - fz);
+    }
+}
+
+/**
+ * \brief Distances between all pairs of two position sets
+ * Result is a from_count x to_count matrix in row order, distance from
+ * point i to point j is dist[i * to_count + j].
+ * Accuracy as nmea_distance_track.
+ */
+void nmea_distance_many2many(
+        const double *from_lat,     /**< From latitudes in radians */
+        const double *from_lon,     /**< From longitudes in radians */
+        int from_count,             /**< Number of from positions */
+        const double *to_lat,       /**< To latitudes in radians */
+        const double *to_lon,       /**< To longitudes in radians */
+        int to_count,               /**< Number of to positions */
+        double *dist                /**< Distances in meters, from_count * to_count elements */
+        )
+{
+    double fx[NMEA_ARRAY_BLOCK], fy[NMEA_ARRAY_BLOCK], fz[NMEA_ARRAY_BLOCK];
+    double x[NMEA_ARRAY_BLOCK], y[NMEA_ARRAY_BLOCK], z[NMEA_ARRAY_BLOCK];
+    double *row;
+    int from_first, from_num, first, num, ir, it;
+
+    for(from_first = 0; from_first < from_count; from_first += from_num)
+    {
+        from_num = from_count - from_first;
+        if(from_num > NMEA_ARRAY_BLOCK)
+            from_num = NMEA_ARRAY_BLOCK;
+
+        _nmea_unit_vectors(from_lat + from_first, from_lon + from_first, from_num, fx, fy, fz);
+
+        for(first = 0; first < to_count; first += num)
+        {
+            num = to_count - first;
+            if(num > NMEA_ARRAY_BLOCK)
+                num = NMEA_ARRAY_BLOCK;
+
+            _nmea_unit_vectors(to_lat + first, to_lon + first, num, x, y, z);
+
+            for(ir = 0; ir < from_num; ++ir)
+            {
+                row = dist + (from_first + ir) * (size_t)to_count + first;
+                for(it = 0; it < num; ++it)
+                    row[it] = _nmea_chord_distance(x[it] - fx[ir], y[it] - fy[ir], z[it] - fz[ir]);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Prepare geodesic context for an origin
+ * Reduced latitude terms of the origin are computed once here and
+ * reused by every inverse and direct problem solved from it.
+ */
+void nmea_geodesic_init(
+        nmeaGEODESIC *geo,          /**< Context */
+        const nmeaPOS *origin       /**< Origin in radians */
+        )
+{
+    NMEA_ASSERT(geo != 0);
+    NMEA_ASSERT(origin != 0);
+
+    geo->origin = *origin;
+    geo->tan_U1 = (1 - NMEA_EARTH_FLATTENING) * tan(origin->lat);
+    geo->cos_U1 = 1 / sqrt(1 + geo->tan_U1 * geo->tan_U1);
+    geo->sin_U1 = geo->tan_U1 * geo->cos_U1;
+    geo->iterations = 0;
+    geo->failed = 0;
+}
+
+/**
+ * \brief Inverse problem from the origin, Vincenty on WGS84
+ * Iteration stops as soon as lambda changes less than 1e-12, usually
+ * after 2 to 4 steps. Steps are added to geo->iterations, points which
+ * did not converge in NMEA_GEODESIC_STEPS (nearly antipodal) are counted
+ * in geo->failed.
+ */
+static double _nmea_geodesic_inverse(
+        nmeaGEODESIC *geo,
+        double lat, double lon,
+        double *from_azimuth,
+        double *to_azimuth
+        )
+{
+    const double f = NMEA_EARTH_FLATTENING;
+    const double b = (1 - NMEA_EARTH_FLATTENING) * NMEA_EARTH_SEMIMAJORAXIS_M;
+    const double ep2 = (NMEA_EARTH_SEMIMAJORAXIS_M * NMEA_EARTH_SEMIMAJORAXIS_M - b * b) / (b * b);
+    double L, tan_U2, sin_U2, cos_U2, ss, cc, sc, cs;
+    double lambda, lambda_prev, sin_lambda = 0, cos_lambda = 1;
+    double sin_sigma = 0, cos_sigma = 1, sigma = 0, sin_alpha, sqr_cos_alpha = 1;
+    double cos_2_sigmam = 0, sqr_cos_2_sigmam, tmp1, tmp2, C;
+    double sqr_u, A, B, delta_sigma;
+    int steps = 0;
+
+    if(lat == geo->origin.lat && lon == geo->origin.lon)
+    {
+        if(from_azimuth)
+            *from_azimuth = 0;
+        if(to_azimuth)
+            *to_azimuth = 0;
+        return 0;
+    }
+
+    L = lon - geo->origin.lon;
+    tan_U2 = (1 - f) * tan(lat);
+    cos_U2 = 1 / sqrt(1 + tan_U2 * tan_U2);
+    sin_U2 = tan_U2 * cos_U2;
+    ss = geo->sin_U1 * sin_U2;
+    cc = geo->cos_U1 * cos_U2;
+    sc = geo->sin_U1 * cos_U2;
+    cs = geo->cos_U1 * sin_U2;
+
+    lambda = L;
+
+    do
+    {
+        sin_lambda = sin(lambda);
+        cos_lambda = cos(lambda);
+        tmp1 = cos_U2 * sin_lambda;
+        tmp2 = cs - sc * cos_lambda;
+        sin_sigma = sqrt(tmp1 * tmp1 + tmp2 * tmp2);
+        cos_sigma = ss + cc * cos_lambda;
+        sigma = atan2(sin_sigma, cos_sigma);
+        sin_alpha = (sin_sigma > 0) ? cc * sin_lambda / sin_sigma : 0;
+        sqr_cos_alpha = 1 - sin_alpha * sin_alpha;
+        cos_2_sigmam = (sqr_cos_alpha > 0) ? cos_sigma - 2 * ss / sqr_cos_alpha : 0;
+        C = f / 16 * sqr_cos_alpha * (4 + f * (4 - 3 * sqr_cos_alpha));
+        lambda_prev = lambda;
+        lambda = L + (1 - C) * f * sin_alpha *
+            (sigma + C * sin_sigma * (cos_2_sigmam + C * cos_sigma * (-1 + 2 * cos_2_sigmam * cos_2_sigmam)));
+        steps++;
+    }
+    while(fabs(lambda - lambda_prev) > 1e-12 && steps < NMEA_GEODESIC_STEPS);
+
+    geo->iterations += steps;
+    if(fabs(lambda - lambda_prev) > 1e-12)
+        geo->failed++;
+
+    sqr_cos_2_sigmam = cos_2_sigmam * cos_2_sigmam;
+    sqr_u = sqr_cos_alpha * ep2;
+    A = 1 + sqr_u / 16384 * (4096 + sqr_u * (-768 + sqr_u * (320 - 175 * sqr_u)));
+    B = sqr_u / 1024 * (256 + sqr_u * (-128 + sqr_u * (74 - 47 * sqr_u)));
+    delta_sigma = B * sin_sigma * (
+        cos_2_sigmam + B / 4 * (
+        cos_sigma * (-1 + 2 * sqr_cos_2_sigmam) -
+        B / 6 * cos_2_sigmam * (-3 + 4 * sin_sigma * sin_sigma) * (-3 + 4 * sqr_cos_2_sigmam)
+        ));
+
+    if(from_azimuth)
+        *from_azimuth = atan2(cos_U2 * sin_lambda, cs - sc * cos_lambda);
+    if(to_azimuth)
+        *to_azimuth = atan2(geo->cos_U1 * sin_lambda, -sc + cs * cos_lambda);
+
+    return b * A * (sigma - delta_sigma);
+}
+
+/**
+ * \brief Distance from the origin of a geodesic context
+ * Unlike nmea_distance_ellipsoid the azimuths are in the full range
+ * (-PI, PI] and distances over a quarter of the globe are correct.
+ * \return Distance in meters
+ */
+double nmea_geodesic_inverse(
+        nmeaGEODESIC *geo,          /**< Context */
+        const nmeaPOS *to_pos,      /**< To position in radians */
+        double *from_azimuth,       /**< (O) azimuth at origin in radians (may be NULL) */
+        double *to_azimuth          /**< (O) azimuth at "to" position in radians (may be NULL) */
+        )
+{
+    NMEA_ASSERT(geo != 0);
+    NMEA_ASSERT(to_pos != 0);
+
+    geo->iterations = 0;
+    geo->failed = 0;
+
+    return _nmea_geodesic_inverse(geo, to_pos->lat, to_pos->lon, from_azimuth, to_azimuth);
+}
+
+/**
+ * \brief Distances from the origin of a geodesic context to many positions
+ * geo->iterations and geo->failed hold the totals over all positions.
+ */
+void nmea_geodesic_inverse_many(
+        nmeaGEODESIC *geo,          /**< Context */
+        const double *lat,          /**< Latitudes in radians */
+        const double *lon,          /**< Longitudes in radians */
+        int count,                  /**< Number of positions */
+        double *dist,               /**< (O) Distances in meters */
+        double *from_azimuth,       /**< (O) Azimuths at origin in radians (may be NULL) */
+        double *to_azimuth          /**< (O) Azimuths at positions in radians (may be NULL) */
+        )
+{
+    int it;
+
+    NMEA_ASSERT(geo != 0);
+
+    geo->iterations = 0;
+    geo->failed = 0;
+
+    for(it = 0; it < count; ++it)
+    {
+        dist[it] = _nmea_geodesic_inverse(
+            geo, lat[it], lon[it],
+            from_azimuth ? from_azimuth + it : 0,
+            to_azimuth ? to_azimuth + it : 0);
+    }
+}
+
+/**
+ * \brief Direct problem from the origin, Vincenty on WGS84
+ * Same iteration as nmea_move_horz_ellipsoid with the origin terms taken
+ * from the context and an early exit once sigma changes less than 1e-12.
+ */
+static int _nmea_geodesic_direct(
+        nmeaGEODESIC *geo,
+        double azimuth,
+        double distance,
+        double *lat, double *lon,
+        double *end_azimuth
+        )
+{
+    const double f = NMEA_EARTH_FLATTENING;
+    const double b = (1 - NMEA_EARTH_FLATTENING) * NMEA_EARTH_SEMIMAJORAXIS_M;
+    const double ep2 = (NMEA_EARTH_SEMIMAJORAXIS_M * NMEA_EARTH_SEMIMAJORAXIS_M - b * b) / (b * b);
+    double sin_alpha1, cos_alpha1, sigma1, sin_alpha, sqr_cos_alpha, sqr_u, A, B;
+    double sigma_initial, sigma, sigma_prev, sin_sigma, cos_sigma, cos_2_sigmam, sqr_cos_2_sigmam;
+    double tmp1, lambda, C;
+    int steps = 0;
+
+    if(fabs(distance) < 1e-12)
+    {
+        *lat = geo->origin.lat;
+        *lon = geo->origin.lon;
+        if(end_azimuth)
+            *end_azimuth = azimuth;
+        return 1;
+    }
+
+    sin_alpha1 = sin(azimuth);
+    cos_alpha1 = cos(azimuth);
+    sigma1 = atan2(geo->tan_U1, cos_alpha1);
+    sin_alpha = geo->cos_U1 * sin_alpha1;
+    sqr_cos_alpha = 1 - sin_alpha * sin_alpha;
+    sqr_u = sqr_cos_alpha * ep2;
+    A = 1 + sqr_u / 16384 * (4096 + sqr_u * (-768 + sqr_u * (320 - 175 * sqr_u)));
+    B = sqr_u / 1024 * (256 + sqr_u * (-128 + sqr_u * (74 - 47 * sqr_u)));
+
+    sigma_initial = distance / (b * A);
+    sigma = sigma_initial;
+
+    do
+    {
+        cos_2_sigmam = cos(2 * sigma1 + sigma);
+        sqr_cos_2_sigmam = cos_2_sigmam * cos_2_sigmam;
+        sin_sigma = sin(sigma);
+        cos_sigma = cos(sigma);
+        sigma_prev = sigma;
+        sigma = sigma_initial + B * sin_sigma * (
+             cos_2_sigmam + B / 4 * (
+             cos_sigma * (-1 + 2 * sqr_cos_2_sigmam) -
+             B / 6 * cos_2_sigmam * (-3 + 4 * sin_sigma * sin_sigma) * (-3 + 4 * sqr_cos_2_sigmam)
+             ));
+        steps++;
+    }
+    while(fabs(sigma - sigma_prev) > 1e-12 && steps < NMEA_GEODESIC_STEPS);
+
+    geo->iterations += steps;
+    if(fabs(sigma - sigma_prev) > 1e-12)
+        geo->failed++;
+
+    /* terms of the last sigma, as in nmea_move_horz_ellipsoid */
+    sigma = sigma_prev;
+
+    tmp1 = geo->sin_U1 * sin_sigma - geo->cos_U1 * cos_sigma * cos_alpha1;
+    *lat = atan2(
+        geo->sin_U1 * cos_sigma + geo->cos_U1 * sin_sigma * cos_alpha1,
+        (1 - f) * sqrt(sin_alpha * sin_alpha + tmp1 * tmp1));
+    lambda = atan2(
+        sin_sigma * sin_alpha1,
+        geo->cos_U1 * cos_sigma - geo->sin_U1 * sin_sigma * cos_alpha1);
+    C = f / 16 * sqr_cos_alpha * (4 + f * (4 - 3 * sqr_cos_alpha));
+    *lon = geo->origin.lon + lambda -
+        (1 - C) * f * sin_alpha * (
+        sigma + C * sin_sigma *
+        (cos_2_sigmam + C * cos_sigma * (-1 + 2 * sqr_cos_2_sigmam)));
+
+    if(end_azimuth)
+        *end_azimuth = atan2(sin_alpha, -tmp1);
+
+    return !(NMEA_POSIX(isnan)(*lat) || NMEA_POSIX(isnan)(*lon));
+}
+
+/**
+ * \brief Move from the origin of a geodesic context
+ * \return 1 on success, 0 if the result is not a number
+ */
+int nmea_geodesic_direct(
+        nmeaGEODESIC *geo,          /**< Context */
+        double azimuth,             /**< Azimuth at origin in radians */
+        double distance,            /**< Distance in meters */
+        nmeaPOS *end_pos,           /**< (O) Result position in radians */
+        double *end_azimuth         /**< (O) Azimuth at end position in radians (may be NULL) */
+        )
+{
+    NMEA_ASSERT(geo != 0);
+    NMEA_ASSERT(end_pos != 0);
+
+    geo->iterations = 0;
+    geo->failed = 0;
+
+    return _nmea_geodesic_direct(geo, azimuth, distance, &end_pos->lat, &end_pos->lon, end_azimuth);
+}
+
+/**
+ * \brief Move from the origin of a geodesic context along many azimuths and distances
+ * geo->iterations and geo->failed hold the totals over all moves.
+ * \return Number of moves with a valid result
+ */
+int nmea_geodesic_direct_many(
+        nmeaGEODESIC *geo,          /**< Context */
+        const double *azimuth,      /**< Azimuths at origin in radians */
+        const double *distance,     /**< Distances in meters */
+        int count,                  /**< Number of moves */
+        double *lat,                /**< (O) Result latitudes in radians */
+        double *lon,                /**< (O) Result longitudes in radians */
+        double *end_azimuth         /**< (O) Azimuths at end positions in radians (may be NULL) */
+        )
+{
+    int it, valid = 0;
+
+    NMEA_ASSERT(geo != 0);
+
+    geo->iterations = 0;
+    geo->failed = 0;
+
+    for(it = 0; it < count; ++it)
+    {
+        valid += _nmea_geodesic_direct(
+            geo, azimuth[it], distance[it], lat + it, lon + it,
+            end_azimuth ? end_azimuth + it : 0);
+    }
+
+    return valid;
+}
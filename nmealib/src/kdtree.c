@@ -0,0 +1,512 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file kdtree.h */
+
+#include "nmea/kdtree.h"
+#include "nmea/ecef.h"
+#include "nmea/context.h"
+
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _nmeaKDBUILD
+{
+    nmeaKDTREE *tree;
+    int    *perm;           /**< Tree order to input order */
+    const double *key[3];   /**< ECEF in input order */
+    const double *lat;
+    const double *lon;
+
+} nmeaKDBUILD;
+
+typedef struct _nmeaKDQUERY
+{
+    const nmeaKDTREE *tree;
+    const double *coord[3];
+    double  q[3];           /**< ECEF of query point */
+    double  r2;             /**< Squared radius */
+    double  min_lat, min_lon, max_lat, max_lon;
+    int    *ids;
+    double *dist;
+    int     max_ids;
+    int     found;
+
+} nmeaKDQUERY;
+
+/**
+ * \brief Move the k-th smallest key of perm[lo, hi) to position k
+ */
+static void nmea_kdtree_select(int *perm, const double *key, int lo, int hi, int k)
+{
+    int i, j, tmp;
+    double pivot;
+
+    for(--hi; hi > lo; )
+    {
+        pivot = key[perm[lo + (hi - lo) / 2]];
+        i = lo;
+        j = hi;
+
+        while(i <= j)
+        {
+            while(key[perm[i]] < pivot) i++;
+            while(key[perm[j]] > pivot) j--;
+            if(i <= j)
+            {
+                tmp = perm[i]; perm[i] = perm[j]; perm[j] = tmp;
+                i++;
+                j--;
+            }
+        }
+
+        if(k <= j)
+            hi = j;
+        else if(k >= i)
+            lo = i;
+        else
+            break;
+    }
+}
+
+static void nmea_kdtree_bound_add(double *bnd, double lat, double lon)
+{
+    if(lat < bnd[0]) bnd[0] = lat;
+    if(lon < bnd[1]) bnd[1] = lon;
+    if(lat > bnd[2]) bnd[2] = lat;
+    if(lon > bnd[3]) bnd[3] = lon;
+}
+
+/**
+ * \brief Build subtree of range [lo, hi) and return its bounds
+ */
+static void nmea_kdtree_split(nmeaKDBUILD *bld, int lo, int hi, double *bnd)
+{
+    double lo_bnd[4], hi_bnd[4], vmin[3], vmax[3], v;
+    int it, ax, axis, m, p;
+
+    bnd[0] = bnd[1] = DBL_MAX;
+    bnd[2] = bnd[3] = -DBL_MAX;
+
+    if(hi - lo <= NMEA_KDTREE_LEAF)
+    {
+        for(it = lo; it < hi; ++it)
+            nmea_kdtree_bound_add(bnd, bld->lat[bld->perm[it]], bld->lon[bld->perm[it]]);
+        return;
+    }
+
+    for(ax = 0; ax < 3; ++ax)
+    {
+        vmin[ax] = DBL_MAX;
+        vmax[ax] = -DBL_MAX;
+        for(it = lo; it < hi; ++it)
+        {
+            v = bld->key[ax][bld->perm[it]];
+            if(v < vmin[ax]) vmin[ax] = v;
+            if(v > vmax[ax]) vmax[ax] = v;
+        }
+    }
+
+    axis = 0;
+    for(ax = 1; ax < 3; ++ax)
+    {
+        if(vmax[ax] - vmin[ax] > vmax[axis] - vmin[axis])
+            axis = ax;
+    }
+
+    m = lo + (hi - lo) / 2;
+    nmea_kdtree_select(bld->perm, bld->key[axis], lo, hi, m);
+    bld->tree->axis[m] = (unsigned char)axis;
+
+    nmea_kdtree_split(bld, lo, m, lo_bnd);
+    nmea_kdtree_split(bld, m + 1, hi, hi_bnd);
+
+    p = bld->perm[m];
+    nmea_kdtree_bound_add(bnd, bld->lat[p], bld->lon[p]);
+    nmea_kdtree_bound_add(bnd, lo_bnd[0], lo_bnd[1]);
+    nmea_kdtree_bound_add(bnd, lo_bnd[2], lo_bnd[3]);
+    nmea_kdtree_bound_add(bnd, hi_bnd[0], hi_bnd[1]);
+    nmea_kdtree_bound_add(bnd, hi_bnd[2], hi_bnd[3]);
+    memcpy(bld->tree->bound + 4 * m, bnd, 4 * sizeof(double));
+}
+
+/**
+ * \brief Bulk load points into a new tree
+ * Build is O(n log n), the tree is static afterwards.
+ * @return true (1) - success or false (0) - fail
+ */
+int nmea_kdtree_build(
+        nmeaKDTREE *tree,
+        const double *lat,      /**< Latitudes in radians */
+        const double *lon,      /**< Longitudes in radians */
+        const double *h,        /**< Heights above ellipsoid in meters (may be NULL) */
+        int count               /**< Number of points */
+        )
+{
+    nmeaKDBUILD bld;
+    double *ecef, bnd[4];
+    char *mem;
+    int it, p;
+
+    NMEA_ASSERT(tree);
+
+    memset(tree, 0, sizeof(nmeaKDTREE));
+
+    if(count <= 0)
+        return 1;
+
+    mem = malloc(count * (9 * sizeof(double) + sizeof(int) + 1));
+    ecef = malloc(count * 3 * sizeof(double));
+    bld.perm = malloc(count * sizeof(int));
+
+    if(!mem || !ecef || !bld.perm)
+    {
+        free(mem);
+        free(ecef);
+        free(bld.perm);
+        nmea_error("Insufficient memory!");
+        return 0;
+    }
+
+    tree->count = count;
+    tree->x = (double *)mem;
+    tree->y = tree->x + count;
+    tree->z = tree->y + count;
+    tree->lat = tree->z + count;
+    tree->lon = tree->lat + count;
+    tree->bound = tree->lon + count;
+    tree->id = (int *)(tree->bound + 4 * count);
+    tree->axis = (unsigned char *)(tree->id + count);
+
+    nmea_geodetic2ecef(lat, lon, h, count, ecef, ecef + count, ecef + 2 * count);
+
+    for(it = 0; it < count; ++it)
+        bld.perm[it] = it;
+
+    bld.tree = tree;
+    bld.key[0] = ecef;
+    bld.key[1] = ecef + count;
+    bld.key[2] = ecef + 2 * count;
+    bld.lat = lat;
+    bld.lon = lon;
+
+    nmea_kdtree_split(&bld, 0, count, bnd);
+
+    for(it = 0; it < count; ++it)
+    {
+        p = bld.perm[it];
+        tree->id[it] = p;
+        tree->x[it] = bld.key[0][p];
+        tree->y[it] = bld.key[1][p];
+        tree->z[it] = bld.key[2][p];
+        tree->lat[it] = lat[p];
+        tree->lon[it] = lon[p];
+    }
+
+    free(ecef);
+    free(bld.perm);
+
+    return 1;
+}
+
+/**
+ * \brief Free memory of the tree
+ */
+void nmea_kdtree_destroy(nmeaKDTREE *tree)
+{
+    free(tree->x);
+    memset(tree, 0, sizeof(nmeaKDTREE));
+}
+
+static void nmea_kdtree_query_init(nmeaKDQUERY *q, const nmeaKDTREE *tree, const nmeaPOS *pos, double h)
+{
+    memset(q, 0, sizeof(nmeaKDQUERY));
+    q->tree = tree;
+    q->coord[0] = tree->x;
+    q->coord[1] = tree->y;
+    q->coord[2] = tree->z;
+
+    if(pos)
+        nmea_geodetic2ecef(&pos->lat, &pos->lon, &h, 1, &q->q[0], &q->q[1], &q->q[2]);
+}
+
+static NMEA_INLINE double nmea_kdtree_dist2(const nmeaKDQUERY *q, int it)
+{
+    double dx = q->tree->x[it] - q->q[0];
+    double dy = q->tree->y[it] - q->q[1];
+    double dz = q->tree->z[it] - q->q[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+static NMEA_INLINE void nmea_kdtree_found(nmeaKDQUERY *q, int it)
+{
+    if(q->found < q->max_ids)
+        q->ids[q->found] = q->tree->id[it];
+    q->found++;
+}
+
+/**
+ * \brief Offer a point to the max-heap of the k nearest
+ */
+static void nmea_kdtree_heap_add(nmeaKDQUERY *q, int id, double d2)
+{
+    int it, child;
+
+    if(q->found < q->max_ids)
+    {
+        for(it = q->found++; it > 0 && q->dist[(it - 1) / 2] < d2; it = (it - 1) / 2)
+        {
+            q->dist[it] = q->dist[(it - 1) / 2];
+            q->ids[it] = q->ids[(it - 1) / 2];
+        }
+    }
+    else if(d2 < q->dist[0])
+    {
+        for(it = 0; (child = 2 * it + 1) < q->found; it = child)
+        {
+            if(child + 1 < q->found && q->dist[child + 1] > q->dist[child])
+                child++;
+            if(q->dist[child] <= d2)
+                break;
+            q->dist[it] = q->dist[child];
+            q->ids[it] = q->ids[child];
+        }
+    }
+    else
+        return;
+
+    q->dist[it] = d2;
+    q->ids[it] = id;
+}
+
+static void nmea_kdtree_nearest_node(nmeaKDQUERY *q, int lo, int hi)
+{
+    int it, m, axis;
+    double d;
+
+    while(hi - lo > NMEA_KDTREE_LEAF)
+    {
+        m = lo + (hi - lo) / 2;
+        axis = q->tree->axis[m];
+        d = q->q[axis] - q->coord[axis][m];
+
+        nmea_kdtree_heap_add(q, q->tree->id[m], nmea_kdtree_dist2(q, m));
+
+        if(d < 0)
+        {
+            nmea_kdtree_nearest_node(q, lo, m);
+            if(q->found == q->max_ids && d * d > q->dist[0])
+                return;
+            lo = m + 1;
+        }
+        else
+        {
+            nmea_kdtree_nearest_node(q, m + 1, hi);
+            if(q->found == q->max_ids && d * d > q->dist[0])
+                return;
+            hi = m;
+        }
+    }
+
+    for(it = lo; it < hi; ++it)
+        nmea_kdtree_heap_add(q, q->tree->id[it], nmea_kdtree_dist2(q, it));
+}
+
+/**
+ * \brief Find the k nearest points
+ * Distance is the straight line between ECEF coordinates, for points
+ * near each other it equals the distance over ground.
+ * @return Number of points found, less than k only if the tree is smaller
+ */
+int nmea_kdtree_nearest(
+        const nmeaKDTREE *tree,
+        const nmeaPOS *pos,     /**< Query position in radians */
+        double h,               /**< Query height above ellipsoid in meters */
+        int k,                  /**< Number of points wanted */
+        int *ids,               /**< (O) Point indices, nearest first, k elements */
+        double *dist            /**< (O) Distances in meters, k elements */
+        )
+{
+    nmeaKDQUERY q;
+    int it, n, child, id;
+    double d2;
+
+    if(k <= 0)
+        return 0;
+
+    nmea_kdtree_query_init(&q, tree, pos, h);
+    q.ids = ids;
+    q.dist = dist;
+    q.max_ids = k;
+
+    nmea_kdtree_nearest_node(&q, 0, tree->count);
+
+    /* heap sort, largest to the end */
+    for(n = q.found - 1; n > 0; --n)
+    {
+        id = ids[n]; d2 = dist[n];
+        ids[n] = ids[0]; dist[n] = dist[0];
+
+        for(it = 0; (child = 2 * it + 1) < n; it = child)
+        {
+            if(child + 1 < n && dist[child + 1] > dist[child])
+                child++;
+            if(dist[child] <= d2)
+                break;
+            dist[it] = dist[child];
+            ids[it] = ids[child];
+        }
+        dist[it] = d2;
+        ids[it] = id;
+    }
+
+    for(it = 0; it < q.found; ++it)
+        dist[it] = sqrt(dist[it]);
+
+    return q.found;
+}
+
+static void nmea_kdtree_radius_node(nmeaKDQUERY *q, int lo, int hi)
+{
+    int it, m, axis;
+    double d;
+
+    while(hi - lo > NMEA_KDTREE_LEAF)
+    {
+        m = lo + (hi - lo) / 2;
+        axis = q->tree->axis[m];
+        d = q->q[axis] - q->coord[axis][m];
+
+        if(nmea_kdtree_dist2(q, m) <= q->r2)
+            nmea_kdtree_found(q, m);
+
+        if(d < 0)
+        {
+            if(d * d <= q->r2)
+                nmea_kdtree_radius_node(q, m + 1, hi);
+            hi = m;
+        }
+        else
+        {
+            if(d * d <= q->r2)
+                nmea_kdtree_radius_node(q, lo, m);
+            lo = m + 1;
+        }
+    }
+
+    for(it = lo; it < hi; ++it)
+    {
+        if(nmea_kdtree_dist2(q, it) <= q->r2)
+            nmea_kdtree_found(q, it);
+    }
+}
+
+/**
+ * \brief Find all points within a radius
+ * Distance as in nmea_kdtree_nearest. Points are in no particular order.
+ * @return Number of points found, may be more than max_ids
+ */
+int nmea_kdtree_radius(
+        const nmeaKDTREE *tree,
+        const nmeaPOS *pos,     /**< Query position in radians */
+        double h,               /**< Query height above ellipsoid in meters */
+        double radius,          /**< Radius in meters */
+        int *ids,               /**< (O) Point indices */
+        int max_ids             /**< Size of ids */
+        )
+{
+    nmeaKDQUERY q;
+
+    nmea_kdtree_query_init(&q, tree, pos, h);
+    q.r2 = radius * radius;
+    q.ids = ids;
+    q.max_ids = max_ids;
+
+    nmea_kdtree_radius_node(&q, 0, tree->count);
+
+    return q.found;
+}
+
+static NMEA_INLINE int nmea_kdtree_inbox(const nmeaKDQUERY *q, double lat, double lon)
+{
+    return lat >= q->min_lat && lat <= q->max_lat && lon >= q->min_lon && lon <= q->max_lon;
+}
+
+static void nmea_kdtree_bbox_node(nmeaKDQUERY *q, int lo, int hi)
+{
+    const double *bnd;
+    int it, m;
+
+    while(hi - lo > NMEA_KDTREE_LEAF)
+    {
+        m = lo + (hi - lo) / 2;
+        bnd = q->tree->bound + 4 * m;
+
+        if(bnd[2] < q->min_lat || bnd[0] > q->max_lat || bnd[3] < q->min_lon || bnd[1] > q->max_lon)
+            return;
+
+        if(nmea_kdtree_inbox(q, bnd[0], bnd[1]) && nmea_kdtree_inbox(q, bnd[2], bnd[3]))
+        { /* whole subtree */
+            for(it = lo; it < hi; ++it)
+                nmea_kdtree_found(q, it);
+            return;
+        }
+
+        if(nmea_kdtree_inbox(q, q->tree->lat[m], q->tree->lon[m]))
+            nmea_kdtree_found(q, m);
+
+        nmea_kdtree_bbox_node(q, lo, m);
+        lo = m + 1;
+    }
+
+    for(it = lo; it < hi; ++it)
+    {
+        if(nmea_kdtree_inbox(q, q->tree->lat[it], q->tree->lon[it]))
+            nmea_kdtree_found(q, it);
+    }
+}
+
+/**
+ * \brief Find all points inside a latitude/longitude box
+ * A box with min_pos->lon greater than max_pos->lon crosses the 180th
+ * meridian. Points are in no particular order.
+ * @return Number of points found, may be more than max_ids
+ */
+int nmea_kdtree_bbox(
+        const nmeaKDTREE *tree,
+        const nmeaPOS *min_pos,     /**< South west corner in radians */
+        const nmeaPOS *max_pos,     /**< North east corner in radians */
+        int *ids,                   /**< (O) Point indices */
+        int max_ids                 /**< Size of ids */
+        )
+{
+    nmeaKDQUERY q;
+
+    nmea_kdtree_query_init(&q, tree, 0, 0);
+    q.ids = ids;
+    q.max_ids = max_ids;
+    q.min_lat = min_pos->lat;
+    q.max_lat = max_pos->lat;
+    q.min_lon = min_pos->lon;
+    q.max_lon = max_pos->lon;
+
+    if(min_pos->lon > max_pos->lon)
+    {
+        q.max_lon = DBL_MAX;
+        nmea_kdtree_bbox_node(&q, 0, tree->count);
+        q.min_lon = -DBL_MAX;
+        q.max_lon = max_pos->lon;
+    }
+
+    nmea_kdtree_bbox_node(&q, 0, tree->count);
+
+    return q.found;
+}
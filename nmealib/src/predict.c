@@ -0,0 +1,179 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file predict.h */
+
+#include "nmea/predict.h"
+#include "nmea/gmath.h"
+#include "nmea/time.h"
+#include "nmea/sentence.h"
+
+#include <math.h>
+#include <string.h>
+
+#define NMEA_PREDICT_R      ((double)NMEA_EARTHRADIUS_M)
+#define NMEA_PREDICT_SMOOTH (0.2)   /**< Weight of the newest error growth sample */
+
+static double nmea_predict_wrap(double a)
+{
+    while(a > NMEA_PI)
+        a -= 2 * NMEA_PI;
+    while(a < -NMEA_PI)
+        a += 2 * NMEA_PI;
+    return a;
+}
+
+/**
+ * \brief Prepare empty predictor with default settings
+ */
+void nmea_predict_init(nmeaPREDICT *pr, int model)
+{
+    memset(pr, 0, sizeof(nmeaPREDICT));
+    pr->model = model;
+    pr->horizon = NMEA_PREDICT_HORIZON;
+}
+
+/**
+ * \brief Take a fix from parser
+ * Speed and direction are used when the fix has GPRMC or GPVTG, else
+ * they are derived from the previous fix. For NMEA_PREDICT_CTRV the turn
+ * rate is the change of direction between the last two fixes. The gap
+ * between the fix and what was predicted for it sets how fast the error
+ * estimate grows. Fixes with NMEA_SIG_BAD are not taken.
+ * @return true (1) - fix taken or false (0) - not
+ */
+int nmea_predict_add_info(
+        nmeaPREDICT *pr,
+        const nmeaINFO *info,
+        double time             /**< Monotonic time the fix was received */
+        )
+{
+    nmeaPOS pos, guess;
+    double utc, dt, dt_utc, speed, direction, sin_dlat, sin_dlon, h, miss;
+
+    if(NMEA_SIG_BAD == info->sig)
+        return 0;
+
+    nmea_info2pos(info, &pos);
+    utc = nmea_time2sec(&info->utc);
+    time -= pr->latency;
+
+    dt = time - pr->time;
+    dt_utc = utc - pr->utc;
+    if(dt_utc <= 0)
+        dt_utc = dt;
+
+    if(pr->count && dt > 0)
+    {
+        nmea_predict(pr, time, &guess, 0);
+        sin_dlat = sin((pos.lat - guess.lat) / 2);
+        sin_dlon = sin((pos.lon - guess.lon) / 2);
+        h = sin_dlat * sin_dlat + cos(pos.lat) * cos(guess.lat) * sin_dlon * sin_dlon;
+        miss = 2 * NMEA_PREDICT_R * asin(sqrt((h < 1) ? h : 1)) / (dt * dt);
+
+        if(pr->count > 1)
+            pr->acc_err += NMEA_PREDICT_SMOOTH * (miss - pr->acc_err);
+        else
+            pr->acc_err = miss;
+    }
+
+    if(info->smask & (GPRMC | GPVTG))
+    {
+        speed = info->speed / 3.6;
+        direction = nmea_degree2radian(info->direction);
+    }
+    else if(pr->count && dt_utc > 0)
+    {
+        sin_dlat = sin((pos.lat - pr->pos.lat) / 2);
+        sin_dlon = sin((pos.lon - pr->pos.lon) / 2);
+        h = sin_dlat * sin_dlat + cos(pos.lat) * cos(pr->pos.lat) * sin_dlon * sin_dlon;
+        speed = 2 * NMEA_PREDICT_R * asin(sqrt((h < 1) ? h : 1)) / dt_utc;
+        direction = atan2(
+            sin(pos.lon - pr->pos.lon) * cos(pos.lat),
+            cos(pr->pos.lat) * sin(pos.lat) - sin(pr->pos.lat) * cos(pos.lat) * cos(pos.lon - pr->pos.lon));
+    }
+    else
+    {
+        speed = 0;
+        direction = 0;
+    }
+
+    pr->turn = 0;
+    if(NMEA_PREDICT_CTRV == pr->model && pr->count && dt_utc > 0 &&
+        speed * 3.6 >= NMEA_PREDICT_MIN_SPEED && pr->speed * 3.6 >= NMEA_PREDICT_MIN_SPEED)
+    {
+        pr->turn = nmea_predict_wrap(direction - pr->direction) / dt_utc;
+        if(pr->turn > NMEA_PREDICT_MAX_TURN)
+            pr->turn = NMEA_PREDICT_MAX_TURN;
+        else if(pr->turn < -NMEA_PREDICT_MAX_TURN)
+            pr->turn = -NMEA_PREDICT_MAX_TURN;
+    }
+
+    pr->pos = pos;
+    pr->time = time;
+    pr->utc = utc;
+    pr->speed = speed;
+    pr->direction = direction;
+    pr->pos_err = nmea_dop2meters((info->HDOP > 0) ? info->HDOP : 1);
+    pr->count++;
+
+    return 1;
+}
+
+/**
+ * \brief Position at a monotonic time
+ * The receiver moves from the last fix along a straight line or, with a
+ * turn rate, an arc; the chord of the arc is one nmea_move_horz, so a
+ * query costs a few trigonometric calls. Times before the fix give the
+ * fix, times beyond the horizon the position at the horizon. The error
+ * estimate is the fix error plus acc_err * dt^2.
+ * @return true (1) - within horizon or false (0) - no fix or stale
+ */
+int nmea_predict(
+        const nmeaPREDICT *pr,
+        double time,        /**< Monotonic time */
+        nmeaPOS *pos,       /**< (O) Position in radians */
+        double *err         /**< (O) Error estimate in meters, may be NULL */
+        )
+{
+    double dt = time - pr->time, half, dist, azimuth;
+    int fresh = 1;
+
+    if(!pr->count)
+    {
+        pos->lat = pos->lon = 0;
+        if(err)
+            *err = 0;
+        return 0;
+    }
+
+    if(dt < 0)
+        dt = 0;
+    else if(dt > pr->horizon)
+    {
+        dt = pr->horizon;
+        fresh = 0;
+    }
+
+    half = pr->turn * dt / 2;
+    azimuth = pr->direction + half;
+    dist = pr->speed * dt;
+    if(fabs(half) > 1e-6)
+        dist *= sin(half) / half;
+
+    if(dist > 0)
+        nmea_move_horz(&pr->pos, pos, nmea_radian2degree(azimuth), dist / 1000);
+    else
+        *pos = pr->pos;
+
+    if(err)
+        *err = pr->pos_err + pr->acc_err * dt * dt;
+
+    return fresh;
+}
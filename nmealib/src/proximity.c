@@ -0,0 +1,234 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file proximity.h */
+
+#include "nmea/proximity.h"
+#include "nmea/ecef.h"
+#include "nmea/gmath.h"
+#include "nmea/sentence.h"
+#include "nmea/context.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int nmea_proximity_hash(const nmeaPROXIMITY *px, int cx, int cy, int cz)
+{
+    return ((unsigned int)cx * 73856093u ^
+        (unsigned int)cy * 19349663u ^
+        (unsigned int)cz * 83492791u) & (unsigned int)(px->table_size - 1);
+}
+
+/**
+ * \brief Prepare tracker of size units, none of them with a position
+ * @return true (1) - success or false (0) - fail
+ */
+int nmea_proximity_init(
+        nmeaPROXIMITY *px,
+        double threshold,   /**< Distance in meters */
+        int size            /**< Number of units */
+        )
+{
+    NMEA_ASSERT(px && threshold > 0 && size > 0);
+
+    memset(px, 0, sizeof(nmeaPROXIMITY));
+    px->threshold = threshold;
+    px->size = size;
+
+    for(px->table_size = 16; px->table_size < 2 * size; px->table_size *= 2)
+        ;
+
+    px->valid = calloc(size, 1);
+    px->lat = calloc(6 * size, sizeof(double));
+    px->cell = malloc(3 * size * sizeof(int));
+    px->order = malloc(size * sizeof(int));
+    px->head = malloc((px->table_size + 1) * sizeof(int));
+
+    if(!px->valid || !px->lat || !px->cell || !px->order || !px->head)
+    {
+        nmea_proximity_destroy(px);
+        nmea_error("Insufficient memory!");
+        return 0;
+    }
+
+    px->lon = px->lat + size;
+    px->h = px->lon + size;
+    px->x = px->h + size;
+    px->y = px->x + size;
+    px->z = px->y + size;
+
+    return 1;
+}
+
+/**
+ * \brief Free memory of tracker
+ */
+void nmea_proximity_destroy(nmeaPROXIMITY *px)
+{
+    free(px->valid);
+    free(px->lat);
+    free(px->cell);
+    free(px->order);
+    free(px->head);
+    memset(px, 0, sizeof(nmeaPROXIMITY));
+}
+
+/**
+ * \brief Take latest position of a unit from parser
+ * Elevation (GPGGA) is used as height when present. A unit with
+ * NMEA_SIG_BAD is left out until it has a fix again.
+ */
+void nmea_proximity_update(nmeaPROXIMITY *px, int unit, const nmeaINFO *info)
+{
+    nmeaPOS pos;
+
+    NMEA_ASSERT(unit >= 0 && unit < px->size);
+
+    if(NMEA_SIG_BAD == info->sig)
+    {
+        px->valid[unit] = 0;
+        return;
+    }
+
+    nmea_info2pos(info, &pos);
+    nmea_proximity_set(px, unit, &pos, (info->smask & GPGGA) ? info->elv : 0);
+}
+
+/**
+ * \brief Set latest position of a unit
+ */
+void nmea_proximity_set(
+        nmeaPROXIMITY *px,
+        int unit,
+        const nmeaPOS *pos, /**< Position in radians */
+        double h            /**< Height in meters */
+        )
+{
+    NMEA_ASSERT(unit >= 0 && unit < px->size);
+
+    px->lat[unit] = pos->lat;
+    px->lon[unit] = pos->lon;
+    px->h[unit] = h;
+    px->valid[unit] = 1;
+}
+
+/**
+ * \brief Leave a unit out of the next epochs
+ */
+void nmea_proximity_remove(nmeaPROXIMITY *px, int unit)
+{
+    NMEA_ASSERT(unit >= 0 && unit < px->size);
+
+    px->valid[unit] = 0;
+}
+
+/**
+ * \brief Find all pairs of units within the threshold
+ * Call once per epoch after the updates. Units are hashed by their ECEF
+ * cube and each is compared with the units of the 27 cubes around it,
+ * which is O(N + pairs) for a fleet not packed much denser than the
+ * threshold. Distance is the straight line between ECEF points, it
+ * differs from the great circle by micrometres at a kilometre.
+ * @return Number of pairs found, pairs are filled up to max_pairs
+ */
+int nmea_proximity_pairs(
+        nmeaPROXIMITY *px,
+        nmeaPROXPAIR *pairs,    /**< (O) Pairs, a < b */
+        int max_pairs           /**< Size of pairs */
+        )
+{
+    double inv_cell = 1 / px->threshold, thr2 = px->threshold * px->threshold;
+    double dx, dy, dz, d2;
+    int it, jt, k, cx, cy, cz, ox, oy, oz, npair = 0;
+    int *cell = px->cell, *head = px->head;
+    unsigned int b;
+
+    /* convert runs of units with a position, the others are skipped */
+    for(it = 0; it < px->size; it = jt)
+    {
+        for(; it < px->size && !px->valid[it]; ++it)
+            ;
+        for(jt = it; jt < px->size && px->valid[jt]; ++jt)
+            ;
+        if(jt > it)
+            nmea_geodetic2ecef(px->lat + it, px->lon + it, px->h + it, jt - it,
+                px->x + it, px->y + it, px->z + it);
+    }
+
+    memset(head, 0, (px->table_size + 1) * sizeof(int));
+
+    for(it = 0; it < px->size; ++it)
+    {
+        if(!px->valid[it])
+            continue;
+        cell[3 * it] = (int)floor(px->x[it] * inv_cell);
+        cell[3 * it + 1] = (int)floor(px->y[it] * inv_cell);
+        cell[3 * it + 2] = (int)floor(px->z[it] * inv_cell);
+        head[nmea_proximity_hash(px, cell[3 * it], cell[3 * it + 1], cell[3 * it + 2]) + 1]++;
+    }
+
+    for(it = 0; it < px->table_size; ++it)
+        head[it + 1] += head[it];
+
+    /* counting sort by bucket, head[b] runs up to the start of bucket b + 1 */
+    for(it = 0; it < px->size; ++it)
+    {
+        if(!px->valid[it])
+            continue;
+        b = nmea_proximity_hash(px, cell[3 * it], cell[3 * it + 1], cell[3 * it + 2]);
+        px->order[head[b]++] = it;
+    }
+
+    for(it = px->table_size; it > 0; --it)
+        head[it] = head[it - 1];
+    head[0] = 0;
+
+    for(it = 0; it < px->size; ++it)
+    {
+        if(!px->valid[it])
+            continue;
+
+        for(ox = -1; ox <= 1; ++ox)
+        for(oy = -1; oy <= 1; ++oy)
+        for(oz = -1; oz <= 1; ++oz)
+        {
+            cx = cell[3 * it] + ox;
+            cy = cell[3 * it + 1] + oy;
+            cz = cell[3 * it + 2] + oz;
+            b = nmea_proximity_hash(px, cx, cy, cz);
+
+            for(k = head[b]; k < head[b + 1]; ++k)
+            {
+                jt = px->order[k];
+                /* buckets are shared by cubes, a unit counts only in its own */
+                if(jt <= it || cell[3 * jt] != cx || cell[3 * jt + 1] != cy || cell[3 * jt + 2] != cz)
+                    continue;
+
+                dx = px->x[jt] - px->x[it];
+                dy = px->y[jt] - px->y[it];
+                dz = px->z[jt] - px->z[it];
+                d2 = dx * dx + dy * dy + dz * dz;
+
+                if(d2 > thr2)
+                    continue;
+
+                if(npair < max_pairs)
+                {
+                    pairs[npair].a = it;
+                    pairs[npair].b = jt;
+                    pairs[npair].dist = sqrt(d2);
+                }
+                npair++;
+            }
+        }
+    }
+
+    return npair;
+}
@@ -0,0 +1,261 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file resample.h */
+
+#include "nmea/resample.h"
+#include "nmea/gmath.h"
+
+#include <math.h>
+
+#define NMEA_RESAMPLE_BLOCK (256)   /**< Segments and samples per pass */
+
+#define NMEA_RESAMPLE_R     ((double)NMEA_EARTHRADIUS_M)
+
+static double nmea_resample_wrap(double dlon)
+{
+    if(dlon > NMEA_PI)
+        dlon -= 2 * NMEA_PI;
+    else if(dlon < -NMEA_PI)
+        dlon += 2 * NMEA_PI;
+    return dlon;
+}
+
+static int nmea_resample_gap(double h, double max_gap)
+{
+    return (h <= 0 || (max_gap > 0 && h > max_gap));
+}
+
+/**
+ * \brief Rate of latitude and longitude at fix it in radians per second
+ * Given velocities are used when present, otherwise the derivative of
+ * the parabola through the fix and its neighbours; next to a gap the
+ * one sided slope.
+ */
+static void nmea_resample_tangent(
+        const double *utc, const double *lat, const double *lon,
+        const double *ve, const double *vn, int count,
+        double max_gap, int it,
+        double *m_lat, double *m_lon
+        )
+{
+    double h0 = 0, h1 = 0, c;
+    int ok0, ok1;
+
+    if(ve && vn)
+    {
+        c = cos(lat[it]);
+        *m_lat = vn[it] / NMEA_RESAMPLE_R;
+        *m_lon = ve[it] / (NMEA_RESAMPLE_R * ((c > 1e-9) ? c : 1e-9));
+        return;
+    }
+
+    if(it > 0)
+        h0 = utc[it] - utc[it - 1];
+    if(it < count - 1)
+        h1 = utc[it + 1] - utc[it];
+
+    ok0 = (it > 0 && !nmea_resample_gap(h0, max_gap));
+    ok1 = (it < count - 1 && !nmea_resample_gap(h1, max_gap));
+
+    if(ok0 && ok1)
+    {
+        *m_lat = ((lat[it] - lat[it - 1]) / h0 * h1 + (lat[it + 1] - lat[it]) / h1 * h0) / (h0 + h1);
+        *m_lon = (nmea_resample_wrap(lon[it] - lon[it - 1]) / h0 * h1 +
+            nmea_resample_wrap(lon[it + 1] - lon[it]) / h1 * h0) / (h0 + h1);
+    }
+    else if(ok0)
+    {
+        *m_lat = (lat[it] - lat[it - 1]) / h0;
+        *m_lon = nmea_resample_wrap(lon[it] - lon[it - 1]) / h0;
+    }
+    else if(ok1)
+    {
+        *m_lat = (lat[it + 1] - lat[it]) / h1;
+        *m_lon = nmea_resample_wrap(lon[it + 1] - lon[it]) / h1;
+    }
+    else
+    {
+        *m_lat = 0;
+        *m_lon = 0;
+    }
+}
+
+/**
+ * \brief Fill samples [from, to) with the position of a fix at rest
+ */
+static void nmea_resample_hold(
+        double lat, double lon, int from, int to,
+        double *out_lat, double *out_lon,
+        double *out_ve, double *out_vn, int *out_flags
+        )
+{
+    int it;
+
+    for(it = from; it < to; ++it)
+    {
+        out_lat[it] = lat;
+        out_lon[it] = lon;
+        if(out_ve && out_vn)
+            out_ve[it] = out_vn[it] = 0;
+        if(out_flags)
+            out_flags[it] = NMEA_RESAMPLE_OUTSIDE;
+    }
+}
+
+/**
+ * \brief Interpolate fixes to a uniform time grid
+ * Sample k is at start + k * step. Each interval between fixes is a
+ * cubic in time (a line for NMEA_RESAMPLE_LINEAR) of latitude and
+ * unwrapped longitude, so positions and velocities of a sample come from
+ * one polynomial and its derivative. Hermite tangents come from ve/vn
+ * when given, else from neighbouring fixes; they are continuous across
+ * fixes, so velocity is too. Intervals longer than max_gap are bridged
+ * linearly and flagged. Coefficients of a block of intervals are made
+ * once and the samples falling in them evaluated in one loop.
+ * @return Number of samples neither in a gap nor outside
+ */
+int nmea_resample(
+        const double *utc, const double *lat, const double *lon,
+        const double *ve, const double *vn, int count,
+        double start, double step, int out_count,
+        double max_gap, int method,
+        double *out_lat, double *out_lon,
+        double *out_ve, double *out_vn, int *out_flags
+        )
+{
+    double c_lat[4][NMEA_RESAMPLE_BLOCK], c_lon[4][NMEA_RESAMPLE_BLOCK];
+    double u[NMEA_RESAMPLE_BLOCK];
+    int idx[NMEA_RESAMPLE_BLOCK], gap[NMEA_RESAMPLE_BLOCK];
+    double m0_lat, m0_lon, m1_lat = 0, m1_lon = 0, h, d_lat, d_lon, t, x, p;
+    int k, n, it, j, seg, s0, s1, valid = 0;
+
+    for(k = 0; k < out_count; ++k)
+    {
+        if(count > 0 && start + k * step >= utc[0])
+            break;
+    }
+
+    nmea_resample_hold(
+        (count > 0) ? lat[0] : 0, (count > 0) ? lon[0] : 0, 0, k,
+        out_lat, out_lon, out_ve, out_vn, out_flags);
+
+    if(count > 1)
+    {
+        nmea_resample_tangent(utc, lat, lon, ve, vn, count, max_gap, 0, &m1_lat, &m1_lon);
+    }
+
+    seg = 0;
+    for(s0 = 0; s0 < count - 1 && k < out_count; s0 = s1)
+    {
+        s1 = s0 + NMEA_RESAMPLE_BLOCK;
+        if(s1 > count - 1)
+            s1 = count - 1;
+
+        for(it = s0; it < s1; ++it)
+        {
+            j = it - s0;
+            m0_lat = m1_lat;
+            m0_lon = m1_lon;
+            nmea_resample_tangent(utc, lat, lon, ve, vn, count, max_gap, it + 1, &m1_lat, &m1_lon);
+
+            h = utc[it + 1] - utc[it];
+            gap[j] = nmea_resample_gap(h, max_gap) ? NMEA_RESAMPLE_GAP : 0;
+            d_lat = lat[it + 1] - lat[it];
+            d_lon = nmea_resample_wrap(lon[it + 1] - lon[it]);
+
+            c_lat[0][j] = lat[it];
+            c_lon[0][j] = lon[it];
+
+            if(h <= 0)
+            {
+                c_lat[1][j] = c_lon[1][j] = 0;
+                c_lat[2][j] = c_lon[2][j] = 0;
+                c_lat[3][j] = c_lon[3][j] = 0;
+            }
+            else if(gap[j] || NMEA_RESAMPLE_LINEAR == method)
+            {
+                c_lat[1][j] = d_lat / h;
+                c_lon[1][j] = d_lon / h;
+                c_lat[2][j] = c_lon[2][j] = 0;
+                c_lat[3][j] = c_lon[3][j] = 0;
+            }
+            else
+            {
+                d_lat /= h;
+                d_lon /= h;
+                c_lat[1][j] = m0_lat;
+                c_lon[1][j] = m0_lon;
+                c_lat[2][j] = (3 * d_lat - 2 * m0_lat - m1_lat) / h;
+                c_lon[2][j] = (3 * d_lon - 2 * m0_lon - m1_lon) / h;
+                c_lat[3][j] = (m0_lat + m1_lat - 2 * d_lat) / (h * h);
+                c_lon[3][j] = (m0_lon + m1_lon - 2 * d_lon) / (h * h);
+            }
+        }
+
+        while(k < out_count)
+        {
+            /* find intervals of the next samples of this block */
+            for(n = 0; n < NMEA_RESAMPLE_BLOCK && k + n < out_count; ++n)
+            {
+                t = start + (k + n) * step;
+                if(t > utc[s1])
+                    break;
+                while(seg < s1 - 1 && utc[seg + 1] < t)
+                    seg++;
+                idx[n] = seg - s0;
+                u[n] = t - utc[seg];
+            }
+
+            for(it = 0; it < n; ++it)
+            {
+                j = idx[it];
+                x = u[it];
+                out_lat[k + it] = c_lat[0][j] + x * (c_lat[1][j] + x * (c_lat[2][j] + x * c_lat[3][j]));
+                p = c_lon[0][j] + x * (c_lon[1][j] + x * (c_lon[2][j] + x * c_lon[3][j]));
+                out_lon[k + it] = nmea_resample_wrap(p);
+            }
+
+            if(out_ve && out_vn)
+            {
+                for(it = 0; it < n; ++it)
+                {
+                    j = idx[it];
+                    x = u[it];
+                    out_vn[k + it] = NMEA_RESAMPLE_R *
+                        (c_lat[1][j] + x * (2 * c_lat[2][j] + 3 * x * c_lat[3][j]));
+                    out_ve[k + it] = NMEA_RESAMPLE_R * cos(out_lat[k + it]) *
+                        (c_lon[1][j] + x * (2 * c_lon[2][j] + 3 * x * c_lon[3][j]));
+                }
+            }
+
+            for(it = 0; it < n; ++it)
+            {
+                if(out_flags)
+                    out_flags[k + it] = gap[idx[it]];
+                valid += !gap[idx[it]];
+            }
+
+            k += n;
+            if(n < NMEA_RESAMPLE_BLOCK)
+                break;
+        }
+
+        seg = s1;
+    }
+
+    if(count > 0)
+    {
+        nmea_resample_hold(
+            lat[count - 1], lon[count - 1], k, out_count,
+            out_lat, out_lon, out_ve, out_vn, out_flags);
+    }
+
+    return valid;
+}
@@ -0,0 +1,274 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*! \file simplify.h */
+
+#include "nmea/simplify.h"
+#include "nmea/ecef.h"
+#include "nmea/context.h"
+
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * \brief Distance of point c from segment a-b in the plane, squared
+ */
+static double nmea_simplify_dist2(const double *e, const double *n, int a, int b, int c)
+{
+    double se = e[b] - e[a], sn = n[b] - n[a];
+    double pe = e[c] - e[a], pn = n[c] - n[a];
+    double len2 = se * se + sn * sn;
+    double t = (len2 > 0) ? (pe * se + pn * sn) / len2 : 0;
+
+    if(t > 1)
+    {
+        pe = e[c] - e[b];
+        pn = n[c] - n[b];
+    }
+    else if(t > 0)
+    {
+        pe -= t * se;
+        pn -= t * sn;
+    }
+
+    return pe * pe + pn * pn;
+}
+
+/**
+ * \brief Douglas-Peucker over the held points
+ * Splits go down to the smallest tolerance. The significance of a point
+ * is its distance when split off, limited by the significance of the
+ * range it split; a point is kept at tolerance t if its significance is
+ * above t. Splits do not depend on the tolerance, so coarser levels keep
+ * a subset of the points of finer ones.
+ */
+static void nmea_simplify_split(nmeaSIMPLIFY *s, int count)
+{
+    nmeaENUREF ref;
+    double *e = s->e, *n = s->n, *sig = s->sig;
+    double min_tol2 = s->tolerance[0] * s->tolerance[0], d2, max_d2, parent;
+    int it, a, b, k, sp = 0;
+
+    for(it = 0; it < count; ++it)
+    {
+        e[it] = s->pt[it].pos.lat;
+        n[it] = s->pt[it].pos.lon;
+        sig[it] = 0;
+    }
+
+    /* in place, u is not needed and goes to sig */
+    nmea_enu_init(&ref, e[0], n[0], 0);
+    nmea_geodetic2enu(&ref, e, n, 0, count, e, n, sig);
+
+    for(it = 0; it < count; ++it)
+        sig[it] = 0;
+    sig[0] = sig[count - 1] = DBL_MAX;
+
+    s->stack[sp++] = 0;
+    s->stack[sp++] = count - 1;
+
+    while(sp > 0)
+    {
+        b = s->stack[--sp];
+        a = s->stack[--sp];
+
+        max_d2 = -1;
+        k = a;
+        for(it = a + 1; it < b; ++it)
+        {
+            d2 = nmea_simplify_dist2(e, n, a, b, it);
+            if(d2 > max_d2)
+            {
+                max_d2 = d2;
+                k = it;
+            }
+        }
+
+        if(max_d2 <= min_tol2)
+            continue;
+
+        parent = (sig[a] < sig[b]) ? sig[a] : sig[b];
+        sig[k] = sqrt(max_d2);
+        if(sig[k] > parent)
+            sig[k] = parent;
+
+        s->stack[sp++] = a;
+        s->stack[sp++] = k;
+        s->stack[sp++] = k;
+        s->stack[sp++] = b;
+    }
+}
+
+static int nmea_simplify_levels(const nmeaSIMPLIFY *s, double sig)
+{
+    int it, levels = 0;
+
+    for(it = 0; it < s->levels; ++it)
+    {
+        if(sig > s->tolerance[it])
+            levels |= 1 << it;
+    }
+
+    return levels;
+}
+
+/**
+ * \brief Emit held points (0, last], last is kept at every level
+ */
+static int nmea_simplify_emit(nmeaSIMPLIFY *s, int last)
+{
+    int it, levels, nout = 0;
+
+    for(it = 1; it <= last; ++it)
+    {
+        levels = (it == last) ? (1 << s->levels) - 1 : nmea_simplify_levels(s, s->sig[it]);
+        if(levels)
+        {
+            s->out[nout] = s->pt[it];
+            s->out[nout].levels = levels;
+            nout++;
+        }
+    }
+
+    return nout;
+}
+
+/**
+ * \brief Prepare simplifier
+ * Tolerance is the largest distance in meters of a dropped point from
+ * the simplified track. Several ascending tolerances are done in one
+ * pass, every emitted point tells at which of them it is kept.
+ * @return true (1) - success or false (0) - fail
+ */
+int nmea_simplify_init(
+        nmeaSIMPLIFY *s,
+        const double *tolerance,    /**< Tolerances in meters, ascending */
+        int levels,                 /**< Number of tolerances, 1 .. NMEA_SIMPLIFY_LEVELS */
+        int window                  /**< Points held, 0 - NMEA_SIMPLIFY_WINDOW */
+        )
+{
+    NMEA_ASSERT(s);
+    NMEA_ASSERT(levels > 0 && levels <= NMEA_SIMPLIFY_LEVELS);
+
+    memset(s, 0, sizeof(nmeaSIMPLIFY));
+    memcpy(s->tolerance, tolerance, levels * sizeof(double));
+    s->levels = levels;
+    s->window = (window > 2) ? window : NMEA_SIMPLIFY_WINDOW;
+
+    s->out = malloc(2 * s->window * sizeof(nmeaSIMPLEPOINT));
+    s->e = malloc(3 * s->window * sizeof(double));
+    s->stack = malloc(2 * s->window * sizeof(int));
+
+    if(!s->out || !s->e || !s->stack)
+    {
+        nmea_simplify_destroy(s);
+        nmea_error("Insufficient memory!");
+        return 0;
+    }
+
+    s->pt = s->out + s->window;
+    s->n = s->e + s->window;
+    s->sig = s->n + s->window;
+
+    return 1;
+}
+
+/**
+ * \brief Free memory of simplifier
+ */
+void nmea_simplify_destroy(nmeaSIMPLIFY *s)
+{
+    free(s->out);
+    free(s->e);
+    free(s->stack);
+    memset(s, 0, sizeof(nmeaSIMPLIFY));
+}
+
+/**
+ * \brief Add next point of the track
+ * When the window is full it is simplified and the points up to a cut
+ * kept at the coarsest possible level are emitted, the rest stays for
+ * the next pass. The cut is in the second half of the window, so every
+ * point is simplified a bounded number of times; if no level keeps a
+ * point there the last point is the cut. Cut points are kept at every
+ * level, where that is forced the points before are simplified again
+ * against the new segment.
+ * @return Number of points emitted to s->out
+ */
+int nmea_simplify_add(nmeaSIMPLIFY *s, const nmeaPOS *pos)
+{
+    int it, level, cut, count;
+
+    s->pt[s->count].pos = *pos;
+    s->pt[s->count].index = s->index++;
+    s->count++;
+
+    if(1 == s->count)
+    {
+        s->out[0] = s->pt[0];
+        s->out[0].levels = (1 << s->levels) - 1;
+        return 1;
+    }
+
+    if(s->count < s->window)
+        return 0;
+
+    count = s->count;
+    nmea_simplify_split(s, count);
+
+    cut = count - 1;
+    for(level = s->levels - 1; level >= 0; --level)
+    {
+        for(it = count - 2; it >= count / 2; --it)
+        {
+            if(s->sig[it] > s->tolerance[level])
+                break;
+        }
+        if(it >= count / 2)
+        {
+            cut = it;
+            break;
+        }
+    }
+
+    /* a cut forced at some level makes a new segment, split again up to it */
+    if(level < s->levels - 1)
+        nmea_simplify_split(s, cut + 1);
+
+    it = nmea_simplify_emit(s, cut);
+
+    memmove(s->pt, s->pt + cut, (count - cut) * sizeof(nmeaSIMPLEPOINT));
+    s->count = count - cut;
+
+    return it;
+}
+
+/**
+ * \brief Simplify and emit the points still held
+ * The last point of the track is kept at every level. The simplifier
+ * is ready for a new track afterwards.
+ * @return Number of points emitted to s->out
+ */
+int nmea_simplify_finish(nmeaSIMPLIFY *s)
+{
+    int nout = 0;
+
+    if(s->count > 1)
+    {
+        nmea_simplify_split(s, s->count);
+        nout = nmea_simplify_emit(s, s->count - 1);
+    }
+
+    s->count = 0;
+    s->index = 0;
+
+    return nout;
+}
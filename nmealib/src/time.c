@@ -24,6 +24,10 @@
 #   include <time.h>
 #endif
 
+#include <math.h>
+
+#define NMEA_DAY_HSEC       (8640000.0)
+
 #ifdef NMEA_WIN
 
 void nmea_time_now(nmeaTIME *stm)
@@ -46,10 +50,12 @@ void nmea_time_now(nmeaTIME *stm)
 void nmea_time_now(nmeaTIME *stm)
 {
     time_t lt;
-    struct tm *tt;
+    struct tm tm;
+    struct tm *tt = &tm;
 
+    /* reentrant, generators may run in several threads */
     time(&lt);
-    tt = gmtime(&lt);
+    gmtime_r(&lt, tt);
 
     stm->year = tt->tm_year;
     stm->mon = tt->tm_mon;
@@ -61,3 +67,48 @@ void nmea_time_now(nmeaTIME *stm)
 }
 
 #endif
+
+/* days since 1970-01-01 of proleptic Gregorian date (mon 1..12) */
+static long nmea_days_from_civil(long year, int mon, int day)
+{
+    long era, yoe, doy, doe;
+
+    year -= (mon <= 2);
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = year - era * 400;
+    doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+double nmea_time2sec(const nmeaTIME *t)
+{
+    long days = nmea_days_from_civil(t->year + 1900L, t->mon + 1, t->day);
+
+    return days * 86400.0 +
+        t->hour * 3600.0 + t->min * 60.0 + t->sec + t->hsec / 100.0;
+}
+
+void nmea_sec2time(double sec, nmeaTIME *t)
+{
+    double hsec = floor(sec * 100 + 0.5);
+    double days = floor(hsec / NMEA_DAY_HSEC);
+    long z, era, doe, yoe, doy, mp, rem;
+
+    rem = (long)(hsec - days * NMEA_DAY_HSEC);
+    z = (long)days + 719468;
+    era = (z >= 0 ? z : z - 146096) / 146097;
+    doe = z - era * 146097;
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+
+    t->day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    t->mon = (int)(mp < 10 ? mp + 2 : mp - 10);
+    t->year = (int)(yoe + era * 400 + (t->mon < 2) - 1900);
+    t->hour = (int)(rem / 360000);
+    t->min = (int)(rem / 6000 % 60);
+    t->sec = (int)(rem / 100 % 60);
+    t->hsec = (int)(rem % 100);
+}
@@ -18,12 +18,17 @@
 #include <ctype.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
+#include <float.h>
 
 #define NMEA_TOKS_COMPARE   (1)
 #define NMEA_TOKS_PERCENT   (2)
 #define NMEA_TOKS_WIDTH     (3)
 #define NMEA_TOKS_TYPE      (4)
 
+#define NMEA_FMT_MAXPREC    (9)
+#define NMEA_FMT_MAXFIXED   (4294967295.0)
+
 /**
  * \brief Calculate control sum of binary buffer
  */
@@ -91,7 +96,10 @@ int nmea_printf(char *buff, int buff_sz, const char *format, ...)
 
     retval = NMEA_POSIX(vsnprintf)(buff, buff_sz, format, arg_ptr);
 
-    if(retval > 0)
+    /* truncated, the checksum would go past the end of buff */
+    if(retval >= buff_sz)
+        retval = -1;
+    else if(retval > 0)
     {
         add = NMEA_POSIX(snprintf)(
             buff + retval, buff_sz - retval, "*%02x\r\n",
@@ -248,3 +256,164 @@ fail:
 
     return tok_count;
 }
+
+/**
+ * \brief Start writing of sentence '$' + head (e.g. "GPGGA")
+ * Functions nmea_fmt_... produce the same bytes as nmea_printf with
+ * the equivalent conversions, but write them straight into the buffer
+ * and update the control sum on the way.
+ */
+void nmea_fmt_begin(nmeaFMT *fmt, char *buff, int buff_sz, const char *head)
+{
+    fmt->buff = buff;
+    fmt->buff_sz = buff_sz;
+    fmt->len = 0;
+    fmt->crc = 0;
+    fmt->error = (buff_sz <= 0);
+
+    if(!fmt->error)
+        fmt->buff[fmt->len++] = '$';
+
+    for(; *head; ++head)
+        nmea_fmt_char(fmt, *head);
+}
+
+/**
+ * \brief Write single character (like "%C")
+ */
+void nmea_fmt_char(nmeaFMT *fmt, int ch)
+{
+    /* "%C" goes through wide char conversion, keep to plain ASCII */
+    if(ch < 0 || ch > 0x7F || fmt->len >= fmt->buff_sz)
+        fmt->error = 1;
+
+    if(fmt->error)
+        return;
+
+    fmt->buff[fmt->len++] = (char)ch;
+    fmt->crc ^= ch;
+}
+
+static void nmea_fmt_digits(nmeaFMT *fmt, int neg, unsigned long val, int width)
+{
+    char tmp[24];
+    int it, count = 0;
+
+    if(width >= (int)sizeof(tmp))
+    {
+        fmt->error = 1;
+        return;
+    }
+
+    do
+    {
+        tmp[count++] = (char)('0' + val % 10);
+        val /= 10;
+    } while(val);
+
+    for(width -= neg; count < width; )
+        tmp[count++] = '0';
+
+    if(neg)
+        nmea_fmt_char(fmt, '-');
+
+    for(it = count - 1; it >= 0; --it)
+        nmea_fmt_char(fmt, tmp[it]);
+}
+
+/**
+ * \brief Write integer number (like "%0<width>d")
+ */
+void nmea_fmt_int(nmeaFMT *fmt, int val, int width)
+{
+    int neg = (val < 0);
+    unsigned long uval = neg?(0UL - (unsigned long)val):(unsigned long)val;
+    nmea_fmt_digits(fmt, neg, uval, width);
+}
+
+/**
+ * \brief Write fraction number (like "%0<width>.<prec>f")
+ * Values which can not be rounded exactly the way printf does it
+ * (ties, NaN, Inf, too big numbers) set the error flag.
+ */
+void nmea_fmt_fixed(nmeaFMT *fmt, double val, int width, int prec)
+{
+    static const double scales[NMEA_FMT_MAXPREC + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+        };
+
+    int neg;
+    double scaled, int_part, fra_part, margin;
+    unsigned long num, scale, ival, fval;
+    char tmp[16];
+    int it;
+
+    if(fmt->error)
+        return;
+
+    if(prec < 0 || prec > NMEA_FMT_MAXPREC || val != val)
+    {
+        fmt->error = 1;
+        return;
+    }
+
+    neg = (val < 0 || (0 == val && 1 / val < 0));
+    scaled = fabs(val) * scales[prec];
+
+    if(!(scaled < NMEA_FMT_MAXFIXED))
+    {
+        fmt->error = 1;
+        return;
+    }
+
+    /* printf rounds the exact binary value, the product above can be
+       off by one ulp, so leave the near-tie cases to printf */
+    int_part = floor(scaled);
+    fra_part = scaled - int_part;
+    margin = scaled * (2 * DBL_EPSILON) + DBL_MIN;
+
+    if(fabs(fra_part - 0.5) <= margin)
+    {
+        fmt->error = 1;
+        return;
+    }
+
+    num = (unsigned long)int_part + (fra_part > 0.5);
+    scale = (unsigned long)scales[prec];
+    ival = num / scale;
+    fval = num % scale;
+
+    nmea_fmt_digits(fmt, neg, ival, width - (prec?prec + 1:0));
+
+    if(prec)
+    {
+        nmea_fmt_char(fmt, '.');
+
+        for(it = prec - 1; it >= 0; --it, fval /= 10)
+            tmp[it] = (char)('0' + fval % 10);
+        for(it = 0; it < prec; ++it)
+            nmea_fmt_char(fmt, tmp[it]);
+    }
+}
+
+/**
+ * \brief Finish sentence with CRC tail (*CRC)
+ * \return Length of sentence or -1 if it has to be produced by nmea_printf
+ */
+int nmea_fmt_end(nmeaFMT *fmt)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    /* tail and terminating zero must fit like with nmea_printf */
+    if(fmt->error || fmt->len + 6 > fmt->buff_sz)
+        return -1;
+
+    fmt->buff[fmt->len++] = '*';
+    fmt->buff[fmt->len++] = hex[(fmt->crc >> 4) & 0x0F];
+    fmt->buff[fmt->len++] = hex[fmt->crc & 0x0F];
+    fmt->buff[fmt->len++] = '\r';
+    fmt->buff[fmt->len++] = '\n';
+    fmt->buff[fmt->len] = '\0';
+
+    return fmt->len;
+}
@@ -0,0 +1,253 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+#include "nmea/track.h"
+#include "nmea/gmath.h"
+#include "nmea/time.h"
+#include "nmea/sentence.h"
+
+#include <math.h>
+#include <string.h>
+
+/**
+ * \brief Great circle distance of one leg in meters
+ * Haversine form on the sphere of nmea_distance, it stays accurate for
+ * the short legs between consecutive fixes.
+ */
+static double nmea_track_leg(const nmeaPOS *from_pos, const nmeaPOS *to_pos)
+{
+    double sin_dlat = sin((to_pos->lat - from_pos->lat) / 2);
+    double sin_dlon = sin((to_pos->lon - from_pos->lon) / 2);
+    double h = sin_dlat * sin_dlat +
+        cos(from_pos->lat) * cos(to_pos->lat) * sin_dlon * sin_dlon;
+
+    return 2 * ((double)NMEA_EARTHRADIUS_M) * asin(sqrt((h < 1) ? h : 1));
+}
+
+/**
+ * \brief Climb or descent from the reference elevation
+ */
+static void nmea_track_elv_step(nmeaTRACKSTAT *st, double elv)
+{
+    if(elv - st->elv_ref > st->elv_hyst)
+    {
+        st->elv_gain += elv - st->elv_ref;
+        st->elv_ref = elv;
+    }
+    else if(st->elv_ref - elv > st->elv_hyst)
+    {
+        st->elv_loss += st->elv_ref - elv;
+        st->elv_ref = elv;
+    }
+}
+
+static void nmea_track_add(
+        nmeaTRACKSTAT *st,
+        const nmeaPOS *pos, double utc,
+        const double *elv, const double *speed
+        )
+{
+    double leg, dt, leg_speed;
+
+    if(!st->pos_count)
+    {
+        st->first_pos = st->last_pos = *pos;
+        st->min_pos = st->max_pos = *pos;
+        st->first_utc = st->last_utc = utc;
+        if(speed && *speed > st->max_speed)
+            st->max_speed = *speed;
+    }
+    else
+    {
+        leg = nmea_track_leg(&st->last_pos, pos);
+        dt = utc - st->last_utc;
+        st->distance += leg;
+
+        if(speed)
+            leg_speed = *speed;
+        else
+            leg_speed = (dt > 0) ? leg / dt * 3.6 : 0;
+
+        if(dt > 0 && leg_speed >= st->moving_speed)
+            st->moving_time += dt;
+        if(leg_speed > st->max_speed)
+            st->max_speed = leg_speed;
+
+        if(pos->lat < st->min_pos.lat) st->min_pos.lat = pos->lat;
+        if(pos->lon < st->min_pos.lon) st->min_pos.lon = pos->lon;
+        if(pos->lat > st->max_pos.lat) st->max_pos.lat = pos->lat;
+        if(pos->lon > st->max_pos.lon) st->max_pos.lon = pos->lon;
+
+        st->last_pos = *pos;
+        st->last_utc = utc;
+    }
+
+    st->pos_count++;
+
+    if(!elv)
+        return;
+
+    if(!st->elv_count)
+    {
+        st->first_elv = st->last_elv = *elv;
+        st->min_elv = st->max_elv = st->elv_ref = *elv;
+    }
+    else
+    {
+        if(*elv < st->min_elv) st->min_elv = *elv;
+        if(*elv > st->max_elv) st->max_elv = *elv;
+        nmea_track_elv_step(st, *elv);
+        st->last_elv = *elv;
+    }
+
+    st->elv_count++;
+}
+
+/**
+ * \brief Start empty statistics with default settings
+ */
+void nmea_track_init(nmeaTRACKSTAT *st)
+{
+    memset(st, 0, sizeof(nmeaTRACKSTAT));
+    st->moving_speed = NMEA_TRACK_MOVING_SPEED;
+}
+
+/**
+ * \brief Add a fix from parser
+ * Uses position, elevation (GPGGA) and speed (GPRMC, GPVTG) when
+ * present. Fixes with NMEA_SIG_BAD are only counted.
+ */
+void nmea_track_add_info(nmeaTRACKSTAT *st, const nmeaINFO *info)
+{
+    nmeaPOS pos;
+
+    st->count++;
+    if(info->sig >= NMEA_SIG_BAD && info->sig <= NMEA_SIG_HIGH)
+        st->sig_count[info->sig]++;
+    if(info->fix >= NMEA_FIX_BAD && info->fix <= NMEA_FIX_3D)
+        st->fix_count[info->fix]++;
+
+    if(NMEA_SIG_BAD == info->sig)
+        return;
+
+    nmea_info2pos(info, &pos);
+    nmea_track_add(
+        st, &pos, nmea_time2sec(&info->utc),
+        (info->smask & GPGGA) ? &info->elv : 0,
+        (info->smask & (GPRMC | GPVTG)) ? &info->speed : 0);
+}
+
+/**
+ * \brief Add a bare position
+ * Speed of the leg is derived from distance and time.
+ */
+void nmea_track_add_pos(
+        nmeaTRACKSTAT *st,
+        const nmeaPOS *pos,     /**< Position in radians */
+        double utc              /**< UTC in seconds since 1970 */
+        )
+{
+    st->count++;
+    nmea_track_add(st, pos, utc, 0, 0);
+}
+
+/**
+ * \brief Join statistics of another piece of the same track
+ * The pieces must follow each other in time, either may be the earlier
+ * one; the leg between them is added. Pieces collected by several threads
+ * are merged pairwise with their neighbours. Elevation gain and loss are
+ * exact for elv_hyst 0, otherwise the hysteresis restarts at the joint.
+ * Settings of st are kept.
+ */
+void nmea_track_merge(nmeaTRACKSTAT *st, const nmeaTRACKSTAT *src)
+{
+    nmeaTRACKSTAT early, late;
+    double leg, dt;
+    int it;
+
+    if(!src->count)
+        return;
+
+    if(src->pos_count && (!st->pos_count || src->first_utc < st->first_utc))
+    {
+        early = *src;
+        late = *st;
+    }
+    else
+    {
+        early = *st;
+        late = *src;
+    }
+
+    early.count += late.count;
+    for(it = 0; it <= NMEA_SIG_HIGH; ++it)
+        early.sig_count[it] += late.sig_count[it];
+    for(it = 0; it <= NMEA_FIX_3D; ++it)
+        early.fix_count[it] += late.fix_count[it];
+
+    if(late.pos_count)
+    {
+        leg = nmea_track_leg(&early.last_pos, &late.first_pos);
+        dt = late.first_utc - early.last_utc;
+
+        early.distance += leg + late.distance;
+        early.moving_time += late.moving_time;
+        if(dt > 0 && leg / dt * 3.6 >= st->moving_speed)
+            early.moving_time += dt;
+        if(late.max_speed > early.max_speed)
+            early.max_speed = late.max_speed;
+
+        if(late.min_pos.lat < early.min_pos.lat) early.min_pos.lat = late.min_pos.lat;
+        if(late.min_pos.lon < early.min_pos.lon) early.min_pos.lon = late.min_pos.lon;
+        if(late.max_pos.lat > early.max_pos.lat) early.max_pos.lat = late.max_pos.lat;
+        if(late.max_pos.lon > early.max_pos.lon) early.max_pos.lon = late.max_pos.lon;
+
+        early.last_pos = late.last_pos;
+        early.last_utc = late.last_utc;
+        early.pos_count += late.pos_count;
+    }
+
+    if(late.elv_count && early.elv_count)
+    {
+        early.elv_hyst = st->elv_hyst;
+        nmea_track_elv_step(&early, late.first_elv);
+        early.elv_gain += late.elv_gain;
+        early.elv_loss += late.elv_loss;
+        early.elv_ref = late.elv_ref;
+
+        if(late.min_elv < early.min_elv) early.min_elv = late.min_elv;
+        if(late.max_elv > early.max_elv) early.max_elv = late.max_elv;
+        early.last_elv = late.last_elv;
+        early.elv_count += late.elv_count;
+    }
+    else if(late.elv_count)
+    {
+        early.first_elv = late.first_elv;
+        early.last_elv = late.last_elv;
+        early.min_elv = late.min_elv;
+        early.max_elv = late.max_elv;
+        early.elv_gain = late.elv_gain;
+        early.elv_loss = late.elv_loss;
+        early.elv_ref = late.elv_ref;
+        early.elv_count = late.elv_count;
+    }
+
+    early.moving_speed = st->moving_speed;
+    early.elv_hyst = st->elv_hyst;
+    *st = early;
+}
+
+/**
+ * \brief Mean speed while moving
+ * \return Speed in km/h, 0 if the track never moved
+ */
+double nmea_track_mean_speed(const nmeaTRACKSTAT *st)
+{
+    return (st->moving_time > 0) ? st->distance / st->moving_time * 3.6 : 0;
+}
